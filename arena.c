@@ -0,0 +1,130 @@
+/**
+ * Bump allocated arena and allocation counting hooked into SDL's memory functions
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGNMENT 64 // a cache line, so nothing allocated shares one with its neighbour
+#define WARM_UP_FRAMES 60  // frames allowed to allocate while SDL and the drivers settle
+
+static uint8_t *arena;
+static size_t arena_size;
+static size_t arena_used;
+
+static _Atomic uint64_t allocations;
+static _Thread_local int untracked;
+
+static SDL_malloc_func sdl_malloc;
+static SDL_calloc_func sdl_calloc;
+static SDL_realloc_func sdl_realloc;
+static SDL_free_func sdl_free;
+
+static void count_allocation(void)
+{
+    if (!untracked)
+    {
+        atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    }
+}
+
+static void *SDLCALL counted_malloc(size_t size)
+{
+    count_allocation();
+    return sdl_malloc(size);
+}
+
+static void *SDLCALL counted_calloc(size_t count, size_t size)
+{
+    count_allocation();
+    return sdl_calloc(count, size);
+}
+
+static void *SDLCALL counted_realloc(void *memory, size_t size)
+{
+    count_allocation();
+    return sdl_realloc(memory, size);
+}
+
+static void SDLCALL counted_free(void *memory)
+{
+    sdl_free(memory);
+}
+
+int init_arena(size_t size)
+{
+    // The rest of the game allocates through SDL_malloc, apart from the engine library's replays,
+    // which use libc, are opened before this and so aren't counted
+    SDL_GetMemoryFunctions(&sdl_malloc, &sdl_calloc, &sdl_realloc, &sdl_free);
+    if (SDL_SetMemoryFunctions(counted_malloc, counted_calloc, counted_realloc, counted_free))
+    {
+        fprintf(stderr, "Unable to count allocations. SDL Error: %s\n", SDL_GetError());
+    }
+
+    arena = SDL_malloc(size);
+    if (!arena)
+    {
+        fprintf(stderr, "Unable to allocate %zu bytes for the arena\n", size);
+        return 1;
+    }
+
+    arena_size = size;
+    arena_used = 0;
+    return 0;
+}
+
+void *arena_alloc(size_t size)
+{
+    uintptr_t next = (uintptr_t)(arena + arena_used);
+    size_t start = arena_used + (-next & (ARENA_ALIGNMENT - 1));
+    if (!arena || start + size > arena_size)
+    {
+        fprintf(stderr, "Arena is out of memory allocating %zu bytes, %zu of %zu used\n", size, arena_used,
+                arena_size);
+        return 0;
+    }
+
+    arena_used = start + size;
+    return memset(arena + start, 0, size);
+}
+
+uint64_t get_allocation_count(void)
+{
+    return atomic_load_explicit(&allocations, memory_order_relaxed);
+}
+
+void untrack_thread_allocations(void)
+{
+    untracked = 1;
+}
+
+void check_frame_allocations(void)
+{
+#if SDL_ASSERT_LEVEL >= 2
+    static int frames;
+    static uint64_t last_count;
+    uint64_t count = get_allocation_count();
+    if (frames < WARM_UP_FRAMES)
+    {
+        frames++;
+    }
+    else if (count != last_count)
+    {
+        fprintf(stderr, "%llu heap allocations in the last frame\n", (unsigned long long)(count - last_count));
+        SDL_assert(count == last_count);
+    }
+
+    last_count = count;
+#endif
+}
+
+void close_arena(void)
+{
+    SDL_free(arena);
+    arena = 0;
+    arena_size = arena_used = 0;
+}
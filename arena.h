@@ -0,0 +1,52 @@
+/**
+ * Memory for resources that last as long as the game, handed out from a
+ * single block allocated at start up, and a count of the heap allocations
+ * made through SDL's memory functions, which the game's own allocations go
+ * through too, so that the frame loop can be checked for any. Allocations in the frame loop stall it unpredictably, especially in
+ * the Web Assembly build.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Allocates the arena and starts counting allocations. Call before SDL_Init
+ * so that all of SDL's allocations are counted.
+ *
+ * @param size bytes available to arena_alloc
+ * @returns    0 on success, 1 if an error was encountered
+ */
+int init_arena(size_t size);
+
+/**
+ * Takes zeroed memory from the arena. It is never freed on its own, only all
+ * at once by close_arena. Must only be called from the main thread.
+ *
+ * @returns the memory, 0 if the arena is full
+ */
+void *arena_alloc(size_t size);
+
+/**
+ * Heap allocations counted so far, across all threads that haven't been
+ * excluded with untrack_thread_allocations.
+ */
+uint64_t get_allocation_count(void);
+
+/**
+ * Stops counting the calling thread's allocations, for threads that do their
+ * work away from the frame loop.
+ */
+void untrack_thread_allocations(void);
+
+/**
+ * Call once per frame drawn. Once the first frames have warmed up any caches,
+ * asserts that nothing has been allocated since the last call. Only checked
+ * in builds with SDL assertions enabled.
+ */
+void check_frame_allocations(void);
+
+/**
+ * Frees the arena and everything taken from it.
+ */
+void close_arena(void);
@@ -0,0 +1,14 @@
+/**
+ * Files from assets/ compiled into the binary. assets.c is generated by the
+ * Makefile with xxd, so the names follow the file paths.
+ */
+#pragma once
+
+extern const unsigned char assets_Arial_ttf[];
+extern const unsigned int assets_Arial_ttf_len;
+
+extern const unsigned char assets_tetris_button_sheet_png[];
+extern const unsigned int assets_tetris_button_sheet_png_len;
+
+extern const unsigned char assets_tetris_go_png[];
+extern const unsigned int assets_tetris_go_png_len;
@@ -0,0 +1,78 @@
+/**
+ * Shelf packing of images into a texture atlas
+ */
+
+#include <stdio.h>
+
+#include "atlas.h"
+
+#define ATLAS_PADDING 1
+
+SDL_Surface *pack_atlas(SDL_Surface **surfaces, int count, int width, SDL_Rect *regions)
+{
+    // Sort tallest first so each row wastes little height
+    int *order = SDL_malloc(count * sizeof(int));
+    if (!order)
+    {
+        fprintf(stderr, "Unable to allocate the atlas packing order\n");
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int j = i;
+        for (; j > 0 && surfaces[order[j - 1]]->h < surfaces[i]->h; j--)
+        {
+            order[j] = order[j - 1];
+        }
+
+        order[j] = i;
+        if (surfaces[i]->w + ATLAS_PADDING * 2 > width)
+        {
+            width = surfaces[i]->w + ATLAS_PADDING * 2;
+        }
+    }
+
+    int x = ATLAS_PADDING, y = ATLAS_PADDING, row_height = 0;
+    for (int i = 0; i < count; i++)
+    {
+        SDL_Surface *surface = surfaces[order[i]];
+        if (x + surface->w + ATLAS_PADDING > width)
+        {
+            x = ATLAS_PADDING;
+            y += row_height + ATLAS_PADDING;
+            row_height = 0;
+        }
+
+        regions[order[i]] = (SDL_Rect){ x, y, surface->w, surface->h };
+        x += surface->w + ATLAS_PADDING;
+        if (surface->h > row_height)
+        {
+            row_height = surface->h;
+        }
+    }
+
+    SDL_free(order);
+
+    // New surfaces are cleared to transparent
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, width, y + row_height + ATLAS_PADDING, 32,
+                                                        SDL_PIXELFORMAT_ARGB8888);
+    if (!atlas)
+    {
+        fprintf(stderr, "Unable to create atlas surface. SDL Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        // Copy alpha as is rather than blending onto the empty atlas
+        SDL_BlendMode blend_mode;
+        SDL_GetSurfaceBlendMode(surfaces[i], &blend_mode);
+        SDL_SetSurfaceBlendMode(surfaces[i], SDL_BLENDMODE_NONE);
+        SDL_Rect region = regions[i];
+        SDL_BlitSurface(surfaces[i], 0, atlas, &region);
+        SDL_SetSurfaceBlendMode(surfaces[i], blend_mode);
+    }
+
+    return atlas;
+}
@@ -0,0 +1,18 @@
+/**
+ * Packs images into a single surface so they can all be drawn from one texture
+ */
+#pragma once
+
+#include <SDL2/SDL.h>
+
+/**
+ * Packs surfaces into rows, tallest first, with a pixel of space around each
+ * so that neighbours never bleed into each other.
+ *
+ * @param surfaces images to pack, they are left unchanged
+ * @param count    number of surfaces
+ * @param width    width of the atlas, widened if an image doesn't fit
+ * @param regions  receives where each surface was placed in the atlas
+ * @returns        the atlas surface, 0 if an error was encountered
+ */
+SDL_Surface *pack_atlas(SDL_Surface **surfaces, int count, int width, SDL_Rect *regions);
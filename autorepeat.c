@@ -0,0 +1,38 @@
+/**
+ * Key repeat timing
+ */
+
+#include "autorepeat.h"
+
+void press_key(held_key *key, uint32_t timestamp)
+{
+    if (!key->held)
+    {
+        *key = (held_key){ 1, timestamp, 0 };
+    }
+}
+
+void release_key(held_key *key)
+{
+    key->held = 0;
+}
+
+int take_repeats(held_key *key, const repeat_timing *timing, uint32_t now_ms)
+{
+    // Signed so that a press stamped a little after now, by a clock read earlier, counts as just pressed
+    int32_t held_ms = (int32_t)(now_ms - key->pressed_ms);
+    if (!key->held || held_ms < (int32_t)timing->delay_ms)
+    {
+        return 0;
+    }
+
+    if (!timing->interval_ms)
+    {
+        return REPEAT_UNLIMITED;
+    }
+
+    uint32_t due = (held_ms - timing->delay_ms) / timing->interval_ms + 1;
+    int repeats = due - key->repeats;
+    key->repeats = due;
+    return repeats;
+}
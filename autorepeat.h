@@ -0,0 +1,47 @@
+/**
+ * Delayed auto shift and auto repeat for held keys. A held key acts once when
+ * pressed, again once it has been held for the delay and then once every
+ * interval after that. Timing is from the key events' own timestamps, so it
+ * doesn't depend on the OS key repeat settings or on when the events happen
+ * to be handled.
+ */
+#pragma once
+
+#include <limits.h>
+#include <stdint.h>
+
+// Returned by take_repeats when the interval is 0 and the key should act as many times as it can
+#define REPEAT_UNLIMITED INT_MAX
+
+typedef struct repeat_timing
+{
+    uint32_t delay_ms;    // held this long before repeating starts
+    uint32_t interval_ms; // between repeats, 0 to repeat as far as possible at once
+} repeat_timing;
+
+typedef struct held_key
+{
+    int held;
+    uint32_t pressed_ms; // timestamp of the press
+    uint32_t repeats;    // repeats taken since the press
+} held_key;
+
+/**
+ * Starts a key repeating. Presses of a key already held are ignored.
+ *
+ * @param timestamp time of the press, in milliseconds
+ */
+void press_key(held_key *key, uint32_t timestamp);
+
+/**
+ * Stops a key repeating.
+ */
+void release_key(held_key *key);
+
+/**
+ * Takes the repeats that have fallen due since they were last taken.
+ *
+ * @param now_ms the time now, on the same clock as the press timestamps
+ * @returns      the number of times to repeat the key's action
+ */
+int take_repeats(held_key *key, const repeat_timing *timing, uint32_t now_ms);
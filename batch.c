@@ -0,0 +1,476 @@
+/**
+ * Plays many independent games across all cores and writes the results of
+ * each one. Games are shared between worker threads with work-stealing
+ * deques so a thread that finishes its own games early helps the others.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bot.h"
+#include "engine.h"
+
+#define DEFAULT_MAX_PIECES 10000
+
+// Sizes of the shared transposition table, log2 of the number of entries
+#define TABLE_SCORE_BITS 20
+#define TABLE_PLACEMENT_BITS 16
+
+/**
+ * Plays the current piece until it locks
+ */
+typedef void (*policy)(engine *engine, rng *rng, transposition_table *table);
+
+/**
+ * Result of one game
+ */
+typedef struct game_result
+{
+    uint64_t seed;
+    int score;
+    int lines;
+    int pieces;
+    int level;
+} game_result;
+
+/**
+ * Writes results as they arrive, in whatever order the games finish
+ */
+typedef struct sink
+{
+    FILE *file;
+    int json;
+    int count;
+    pthread_mutex_t lock;
+} sink;
+
+/**
+ * Games waiting to be played by one worker. Only the owner takes from the
+ * bottom, any thread may steal from the top. All the games are added before
+ * the workers start so nothing is ever pushed.
+ */
+typedef struct deque
+{
+    atomic_long top;
+    atomic_long bottom;
+    int *games;          // indexes into the seed list
+} deque;
+
+typedef struct batch
+{
+    const uint64_t *seeds;
+    randomizer randomizer;
+    policy policy;
+    int max_pieces;
+    deque *deques;
+    int num_workers;
+    transposition_table *table; // shared by all of the workers
+    sink sink;
+} batch;
+
+typedef struct worker
+{
+    batch *batch;
+    int id;
+    long played;
+} worker;
+
+/**
+ * Takes the most recently added game from the worker's own deque.
+ *
+ * @returns 1 if a game was taken, 0 if the deque is empty
+ */
+static int pop_game(deque *deque, int *game)
+{
+    long bottom = atomic_load(&deque->bottom) - 1;
+    atomic_store(&deque->bottom, bottom);
+    long top = atomic_load(&deque->top);
+    if (top > bottom)
+    {
+        atomic_store(&deque->bottom, bottom + 1);
+        return 0;
+    }
+
+    *game = deque->games[bottom];
+    if (top < bottom)
+    {
+        return 1;
+    }
+
+    // Last game in the deque, thieves may be after it too
+    int won = atomic_compare_exchange_strong(&deque->top, &top, top + 1);
+    atomic_store(&deque->bottom, bottom + 1);
+    return won;
+}
+
+/**
+ * Takes the oldest game from another worker's deque.
+ *
+ * @returns 1 if a game was taken, 0 if the deque is empty, -1 if another
+ *          thread took the game first
+ */
+static int steal_game(deque *deque, int *game)
+{
+    long top = atomic_load(&deque->top);
+    long bottom = atomic_load(&deque->bottom);
+    if (top >= bottom)
+    {
+        return 0;
+    }
+
+    *game = deque->games[top];
+    return atomic_compare_exchange_strong(&deque->top, &top, top + 1) ? 1 : -1;
+}
+
+/**
+ * Finds the next game for a worker, from its own deque first.
+ *
+ * @returns 1 if a game was found, 0 once every deque is empty
+ */
+static int next_game(batch *batch, int id, int *game)
+{
+    if (pop_game(&batch->deques[id], game))
+    {
+        return 1;
+    }
+
+    int contended;
+    do
+    {
+        contended = 0;
+        for (int i = 1; i < batch->num_workers; i++)
+        {
+            int result = steal_game(&batch->deques[(id + i) % batch->num_workers], game);
+            if (result == 1)
+            {
+                return 1;
+            }
+
+            contended |= result < 0;
+        }
+    } while (contended);
+
+    return 0;
+}
+
+/**
+ * Rotates a random number of times, moves towards a random column and drops
+ */
+static void play_random(engine *engine, rng *rng, transposition_table *table)
+{
+    (void)table;
+    int rotations = rng_range(rng, NUM_DIRECTIONS);
+    for (int i = 0; i < rotations; i++)
+    {
+        engine_step(engine, ACTION_ROTATE_CW);
+    }
+
+    int column = (int)rng_range(rng, GRID_CELL_WIDTH) - 1;
+    engine_action action = column < engine->shape.x ? ACTION_LEFT : ACTION_RIGHT;
+    while (engine->shape.x != column && engine_step(engine, action) & EVENT_MOVED)
+    {
+    }
+
+    engine_step(engine, ACTION_DROP);
+}
+
+/**
+ * Places the piece where the bot chooses. A search this shallow rarely meets
+ * a position twice, so it does without the transposition table.
+ */
+static void play_bot(engine *engine, rng *rng, transposition_table *table)
+{
+    (void)rng;
+    (void)table;
+    placement placement;
+    bot_choose(engine, 0, 0, &placement);
+    bot_play(engine, &placement);
+}
+
+/**
+ * Places the piece where the bot chooses, taking the next piece into account
+ */
+static void play_bot_lookahead(engine *engine, rng *rng, transposition_table *table)
+{
+    (void)rng;
+    placement placement;
+    bot_choose(engine, 1, table, &placement);
+    bot_play(engine, &placement);
+}
+
+static void play_game(batch *batch, uint64_t seed, game_result *result)
+{
+    engine engine;
+    engine_init(&engine, seed, batch->randomizer);
+
+    // The policy has its own generator so that it doesn't change the pieces dealt
+    rng rng;
+    rng_seed(&rng, ~seed);
+    // The count includes the piece in play, so stop with max_pieces dealt
+    while (engine.state.action == RUNNING && engine.state.num_pieces < batch->max_pieces)
+    {
+        batch->policy(&engine, &rng, batch->table);
+    }
+
+    result->seed = seed;
+    result->score = engine.state.score;
+    result->lines = engine.state.lines;
+    result->pieces = engine.state.num_pieces;
+    result->level = get_level(&engine.state);
+}
+
+static void write_result(sink *sink, const game_result *result)
+{
+    pthread_mutex_lock(&sink->lock);
+    if (sink->json)
+    {
+        fprintf(sink->file, "%s\n  {\"seed\":%llu,\"score\":%d,\"lines\":%d,\"pieces\":%d,\"level\":%d}",
+                sink->count ? "," : "", (unsigned long long)result->seed, result->score, result->lines,
+                result->pieces, result->level);
+    }
+    else
+    {
+        fprintf(sink->file, "%llu,%d,%d,%d,%d\n", (unsigned long long)result->seed, result->score,
+                result->lines, result->pieces, result->level);
+    }
+
+    sink->count++;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static void *run_worker(void *data)
+{
+    worker *worker = data;
+    batch *batch = worker->batch;
+    game_result result;
+    int game;
+    while (next_game(batch, worker->id, &game))
+    {
+        play_game(batch, batch->seeds[game], &result);
+        write_result(&batch->sink, &result);
+        worker->played++;
+    }
+
+    return 0;
+}
+
+/**
+ * Reads whitespace separated seeds
+ *
+ * @returns the seeds, 0 if an error was encountered
+ */
+static uint64_t *read_seeds(const char *path, int *count)
+{
+    FILE *file = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!file)
+    {
+        fprintf(stderr, "Unable to open seed file %s\n", path);
+        return 0;
+    }
+
+    int capacity = 1024;
+    uint64_t *seeds = malloc(capacity * sizeof(uint64_t));
+    unsigned long long seed;
+    *count = 0;
+    while (seeds && fscanf(file, "%llu", &seed) == 1)
+    {
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            uint64_t *grown = realloc(seeds, capacity * sizeof(uint64_t));
+            if (!grown)
+            {
+                free(seeds);
+                seeds = 0;
+                break;
+            }
+
+            seeds = grown;
+        }
+
+        seeds[(*count)++] = seed;
+    }
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+
+    if (!seeds)
+    {
+        fprintf(stderr, "Unable to allocate the seeds from %s\n", path);
+    }
+
+    return seeds;
+}
+
+static int open_sink(sink *sink, const char *path)
+{
+    sink->file = path ? fopen(path, "w") : stdout;
+    if (!sink->file)
+    {
+        fprintf(stderr, "Unable to open output file %s\n", path);
+        return 1;
+    }
+
+    size_t length = path ? strlen(path) : 0;
+    sink->json = length > 5 && !strcmp(path + length - 5, ".json");
+    fprintf(sink->file, sink->json ? "[" : "seed,score,lines,pieces,level\n");
+    pthread_mutex_init(&sink->lock, 0);
+    return 0;
+}
+
+static void close_sink(sink *sink)
+{
+    if (sink->json)
+    {
+        fprintf(sink->file, "\n]\n");
+    }
+
+    if (sink->file != stdout)
+    {
+        fclose(sink->file);
+    }
+
+    pthread_mutex_destroy(&sink->lock);
+}
+
+int main(int argc, char *argv[])
+{
+    batch batch = { .randomizer = RANDOMIZER_UNIFORM, .policy = play_bot, .max_pieces = DEFAULT_MAX_PIECES };
+    int num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *output_path = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:bm:o:p:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            num_workers = atoi(optarg);
+            break;
+        case 'b':
+            batch.randomizer = RANDOMIZER_BAG;
+            break;
+        case 'm':
+            batch.max_pieces = atoi(optarg);
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'p':
+            if (!strcmp(optarg, "random"))
+            {
+                batch.policy = play_random;
+            }
+            else if (!strcmp(optarg, "lookahead"))
+            {
+                batch.policy = play_bot_lookahead;
+            }
+            else if (strcmp(optarg, "bot"))
+            {
+                optind = argc;
+            }
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+
+    if (optind != argc - 1 || num_workers < 1)
+    {
+        fprintf(stderr, "Usage: %s [-j threads] [-b] [-m max_pieces] [-o results.csv|results.json] "
+                        "[-p bot|lookahead|random] seed_file\n",
+                argv[0]);
+        return 1;
+    }
+
+    int num_games;
+    uint64_t *seeds = read_seeds(argv[optind], &num_games);
+    if (!seeds || open_sink(&batch.sink, output_path))
+    {
+        return 1;
+    }
+
+    init_tetronimoes();
+    batch.table = open_transposition_table(TABLE_SCORE_BITS, TABLE_PLACEMENT_BITS);
+    if (!batch.table)
+    {
+        return 1;
+    }
+
+    // Deal the games out round robin, stealing evens out any imbalance
+    batch.seeds = seeds;
+    batch.num_workers = num_workers;
+    batch.deques = calloc(num_workers, sizeof(deque));
+    if (!batch.deques)
+    {
+        fprintf(stderr, "Unable to allocate the work queues\n");
+        return 1;
+    }
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        deque *deque = &batch.deques[i];
+        deque->games = malloc((num_games / num_workers + 1) * sizeof(int));
+        if (!deque->games)
+        {
+            fprintf(stderr, "Unable to allocate the work queues\n");
+            return 1;
+        }
+
+        long count = 0;
+        for (int game = i; game < num_games; game += num_workers)
+        {
+            deque->games[count++] = game;
+        }
+
+        atomic_init(&deque->top, 0);
+        atomic_init(&deque->bottom, count);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t *threads = malloc(num_workers * sizeof(pthread_t));
+    worker *workers = calloc(num_workers, sizeof(worker));
+    if (!threads || !workers)
+    {
+        fprintf(stderr, "Unable to allocate the workers\n");
+        return 1;
+    }
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers[i] = (worker){ &batch, i, 0 };
+        pthread_create(&threads[i], 0, run_worker, &workers[i]);
+    }
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        pthread_join(threads[i], 0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%d games on %d threads in %.3f seconds, %.0f games/s\n", num_games, num_workers, seconds,
+            num_games / seconds);
+
+    close_sink(&batch.sink);
+    close_transposition_table(batch.table);
+    for (int i = 0; i < num_workers; i++)
+    {
+        free(batch.deques[i].games);
+    }
+
+    free(batch.deques);
+    free(workers);
+    free(threads);
+    free(seeds);
+    return 0;
+}
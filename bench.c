@@ -0,0 +1,390 @@
+/**
+ * Microbenchmarks for the game engine and the renderer. Results are written as
+ * JSON so they can be compared between versions. The SIMD feature kernels are
+ * checked against the scalar reference first, -c does only the check.
+ *
+ * Usage: tetris_bench [-c] [output.json]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "arena.h"
+#include "board_features.h"
+#include "bot.h"
+#include "engine.h"
+#include "graphics.h"
+#include "rng.h"
+#include "scene.h"
+#include "zobrist.h"
+
+#define FIXTURE_SEED 12345
+#define NUM_FIXTURES 64
+#define NUM_POSITIONS 1024
+#define ARENA_SIZE (256 * 1024)
+
+/**
+ * Boards and shape positions shared by the benchmarks, generated from a fixed seed
+ */
+typedef struct fixtures
+{
+    board boards[NUM_FIXTURES];
+    shape shapes[NUM_POSITIONS];
+    transposition_table *table; // opened once so its allocation isn't timed, filled by the warm up
+} fixtures;
+
+typedef struct result
+{
+    const char *name;
+    long iterations;
+    double ns_per_op;
+} result;
+
+typedef void (*bench_fn)(fixtures *fixtures, long iterations);
+
+// Results are accumulated here so the compiler can't optimise the work away
+static volatile long sink;
+
+/**
+ * Builds a board with a ragged stack of rows, each missing one or two cells
+ */
+static void make_board(board *board, rng *rng)
+{
+    board_clear(board);
+    int height = rng_range(rng, GRID_CELL_HEIGHT - 4);
+    for (int row = GRID_CELL_HEIGHT - height; row < GRID_CELL_HEIGHT; row++)
+    {
+        int gap1 = rng_range(rng, GRID_CELL_WIDTH);
+        int gap2 = rng_range(rng, GRID_CELL_WIDTH);
+        for (int col = 0; col < GRID_CELL_WIDTH; col++)
+        {
+            if (col != gap1 && col != gap2)
+            {
+                uint8_t cell[MATRIX_SIZE] = { 1 };
+                board_place(board, cell, col, row, rng_range(rng, BLUE) + 1);
+            }
+        }
+    }
+}
+
+static void make_fixtures(fixtures *fixtures)
+{
+    rng rng;
+    rng_seed(&rng, FIXTURE_SEED);
+    for (int i = 0; i < NUM_FIXTURES; i++)
+    {
+        make_board(&fixtures->boards[i], &rng);
+    }
+
+    for (int i = 0; i < NUM_POSITIONS; i++)
+    {
+        shape *shape = &fixtures->shapes[i];
+        shape->piece = rng_range(&rng, NUM_TETRONIMOES);
+        shape->direction = rng_range(&rng, NUM_DIRECTIONS);
+        shape->color = rng_range(&rng, BLUE) + 1;
+        shape->x = (int)rng_range(&rng, GRID_CELL_WIDTH + 2) - 2;
+        shape->y = rng_range(&rng, GRID_CELL_HEIGHT);
+    }
+}
+
+static void bench_is_position_valid(fixtures *fixtures, long iterations)
+{
+    long valid = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        shape *shape = &fixtures->shapes[i & (NUM_POSITIONS - 1)];
+        valid += is_position_valid(get_tetronimo(shape->piece, shape->direction), shape->x, shape->y,
+                                   &fixtures->boards[i & (NUM_FIXTURES - 1)]);
+    }
+
+    sink += valid;
+}
+
+static void bench_rotate(fixtures *fixtures, long iterations)
+{
+    long valid = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        shape *shape = &fixtures->shapes[i & (NUM_POSITIONS - 1)];
+        direction direction = rotate(shape->piece, shape->direction, NINETY_DEGREES);
+        valid += is_position_valid(get_tetronimo(shape->piece, direction), shape->x, shape->y,
+                                   &fixtures->boards[i & (NUM_FIXTURES - 1)]);
+    }
+
+    sink += valid;
+}
+
+/**
+ * Locks a shape at the lowest point it fits in its column and removes any rows it completes.
+ * Includes the cost of copying the board.
+ */
+static void bench_lock_and_clear(fixtures *fixtures, long iterations)
+{
+    long cleared = 0;
+    board board;
+    for (long i = 0; i < iterations; i++)
+    {
+        shape *shape = &fixtures->shapes[i & (NUM_POSITIONS - 1)];
+        const tetronimo *tetronimo = get_tetronimo(shape->piece, shape->direction);
+        int x = shape->x;
+        board = fixtures->boards[i & (NUM_FIXTURES - 1)];
+        if (!board_fits(&board, tetronimo->rows, x, 0))
+        {
+            continue;
+        }
+
+        int y = 0;
+        while (board_fits(&board, tetronimo->rows, x, y + 1))
+        {
+            y++;
+        }
+
+        board_place(&board, tetronimo->rows, x, y, shape->color);
+        cleared += board_clear_full_rows(&board, y, MATRIX_SIZE);
+    }
+
+    sink += cleared;
+}
+
+/**
+ * Plays whole pieces through the engine -- a few moves and rotations then a hard drop
+ */
+static void bench_piece_cycle(fixtures *fixtures, long iterations)
+{
+    (void)fixtures;
+    static const engine_action moves[] = { ACTION_LEFT, ACTION_RIGHT, ACTION_ROTATE_CW, ACTION_ROTATE_CCW, ACTION_DOWN };
+    engine engine;
+    rng rng;
+    engine_init(&engine, FIXTURE_SEED, RANDOMIZER_BAG);
+    rng_seed(&rng, FIXTURE_SEED);
+    for (long i = 0; i < iterations; i++)
+    {
+        for (int m = rng_range(&rng, 6); m > 0; m--)
+        {
+            engine_step(&engine, moves[rng_range(&rng, 5)]);
+        }
+
+        if (engine_step(&engine, ACTION_DROP) & EVENT_GAME_OVER)
+        {
+            engine_step(&engine, ACTION_RESTART);
+        }
+    }
+
+    sink += engine.state.score;
+}
+
+/**
+ * Measures the fixture boards in batches, as the bot does with the boards from its placements
+ */
+static void bench_extract_features(fixtures *fixtures, long iterations)
+{
+    board_features features[NUM_FIXTURES];
+    long holes = 0;
+    for (long i = 0; i < iterations; i += NUM_FIXTURES)
+    {
+        extract_features_batch(fixtures->boards, NUM_FIXTURES, features);
+        holes += features[i & (NUM_FIXTURES - 1)].holes;
+    }
+
+    sink += holes;
+}
+
+/**
+ * Chooses a placement for a freshly spawned shape on each of the fixture boards
+ */
+static void bench_bot(fixtures *fixtures, long iterations, int lookahead, transposition_table *table)
+{
+    engine engine;
+    placement placement;
+    engine_init(&engine, FIXTURE_SEED, RANDOMIZER_BAG);
+    shape *shape = &engine.shape;
+    for (long i = 0; i < iterations; i++)
+    {
+        engine.board = fixtures->boards[i & (NUM_FIXTURES - 1)];
+        shape->piece = i % NUM_TETRONIMOES;
+        shape->key = zobrist_shape(shape->piece, shape->direction, shape->x, shape->y);
+        bot_choose(&engine, lookahead, table, &placement);
+        sink += placement.x;
+    }
+}
+
+static void bench_bot_choose(fixtures *fixtures, long iterations)
+{
+    bench_bot(fixtures, iterations, 0, 0);
+}
+
+static void bench_bot_lookahead(fixtures *fixtures, long iterations)
+{
+    bench_bot(fixtures, iterations, 1, 0);
+}
+
+/**
+ * The fixture boards come round again every NUM_FIXTURES iterations, so once warmed
+ * up this is the cost of a search whose positions are all in the transposition table
+ */
+static void bench_bot_lookahead_cached(fixtures *fixtures, long iterations)
+{
+    bench_bot(fixtures, iterations, 1, fixtures->table);
+}
+
+/**
+ * Renders frames offscreen with the software renderer. Rebuilding the background each frame
+ * gives the cost of a frame in which a shape locks.
+ */
+static void bench_frames(long iterations, int events, graphics *graphics, scene *scene, engine *engine)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        render_scene(scene, graphics, engine, 0, events);
+        commit_to_screen(graphics);
+    }
+}
+
+static double elapsed_ns(uint64_t start)
+{
+    return (double)(SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency();
+}
+
+static result run(const char *name, bench_fn fn, fixtures *fixtures, long iterations)
+{
+    fn(fixtures, iterations / 10); // warm up
+    uint64_t start = SDL_GetPerformanceCounter();
+    fn(fixtures, iterations);
+    return (result){ name, iterations, elapsed_ns(start) / iterations };
+}
+
+/**
+ * Runs the render benchmarks headless so no display is needed
+ *
+ * @returns the number of results added
+ */
+static int run_frames(result *results, fixtures *fixtures, long iterations)
+{
+    graphics *graphics = init_arena(ARENA_SIZE) ? 0 : init_graphics(GRAPHICS_HEADLESS);
+    scene *scene = graphics ? init_scene(graphics) : 0;
+    if (!scene)
+    {
+        fprintf(stderr, "Unable to set up rendering, skipping frame benchmarks\n");
+        return 0;
+    }
+
+    engine engine;
+    engine_init(&engine, FIXTURE_SEED, RANDOMIZER_BAG);
+    engine.board = fixtures->boards[0];
+
+    int events[] = { 0, EVENT_LOCKED };
+    const char *names[] = { "frame", "frame_with_lock" };
+    for (int i = 0; i < 2; i++)
+    {
+        bench_frames(iterations / 10, events[i], graphics, scene, &engine);
+        uint64_t start = SDL_GetPerformanceCounter();
+        bench_frames(iterations, events[i], graphics, scene, &engine);
+        results[i] = (result){ names[i], iterations, elapsed_ns(start) / iterations };
+    }
+
+    close_scene(scene);
+    close_graphics(graphics);
+    close_arena();
+    return 2;
+}
+
+/**
+ * Compares the SIMD feature kernels with the scalar reference over the fixture
+ * boards, measuring every number of boards up to the lot so partly filled
+ * groups are covered too.
+ *
+ * @returns 0 if they agree, 1 otherwise
+ */
+static int check_features(const fixtures *fixtures)
+{
+    board_features expected[NUM_FIXTURES], actual[NUM_FIXTURES];
+    for (int i = 0; i < NUM_FIXTURES; i++)
+    {
+        extract_features_reference(&fixtures->boards[i], &expected[i]);
+    }
+
+    for (int count = 1; count <= NUM_FIXTURES; count++)
+    {
+        extract_features_batch(fixtures->boards, count, actual);
+        for (int i = 0; i < count; i++)
+        {
+            if (memcmp(&actual[i], &expected[i], sizeof(board_features)))
+            {
+                fprintf(stderr, "Features of fixture board %d differ from the reference in a batch of %d\n",
+                        i, count);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void write_results(FILE *file, result *results, int count)
+{
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (int i = 0; i < count; i++)
+    {
+        fprintf(file, "    { \"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f }%s\n",
+                results[i].name, results[i].iterations, results[i].ns_per_op, i < count - 1 ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    init_tetronimoes();
+
+    fixtures *fixtures = malloc(sizeof(struct fixtures));
+    if (!fixtures)
+    {
+        fprintf(stderr, "Unable to allocate the benchmark fixtures\n");
+        return 1;
+    }
+
+    make_fixtures(fixtures);
+    int failed = check_features(fixtures);
+    if (failed || (argc > 1 && !strcmp(argv[1], "-c")))
+    {
+        free(fixtures);
+        return failed;
+    }
+
+    fixtures->table = open_transposition_table(20, 16);
+    if (!fixtures->table)
+    {
+        return 1;
+    }
+
+    result results[16];
+    int count = 0;
+    results[count++] = run("is_position_valid", bench_is_position_valid, fixtures, 50000000);
+    results[count++] = run("rotate", bench_rotate, fixtures, 50000000);
+    results[count++] = run("lock_and_clear", bench_lock_and_clear, fixtures, 10000000);
+    results[count++] = run("piece_cycle", bench_piece_cycle, fixtures, 5000000);
+    results[count++] = run("extract_features", bench_extract_features, fixtures, 10000000);
+    results[count++] = run("bot_choose", bench_bot_choose, fixtures, 200000);
+    results[count++] = run("bot_lookahead", bench_bot_lookahead, fixtures, 5000);
+    results[count++] = run("bot_lookahead_cached", bench_bot_lookahead_cached, fixtures, 5000);
+    count += run_frames(&results[count], fixtures, 2000);
+
+    FILE *file = argc > 1 ? fopen(argv[1], "w") : stdout;
+    if (!file)
+    {
+        fprintf(stderr, "Unable to open %s\n", argv[1]);
+        return 1;
+    }
+
+    write_results(file, results, count);
+    if (file != stdout)
+    {
+        fclose(file);
+    }
+
+    close_transposition_table(fixtures->table);
+    free(fixtures);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * Bitboard play area. Collision, locking and full row checks are a handful
+ * of mask operations per shape row rather than loops over every cell.
+ */
+
+#include <string.h>
+#include "board.h"
+#include "zobrist.h"
+
+void board_clear(board *board)
+{
+    for (int i = 0; i < GRID_CELL_HEIGHT; i++)
+    {
+        board->rows[i] = BOARD_EMPTY_ROW;
+    }
+
+    memset(board->colors, 0, sizeof(board->colors));
+    board->hash = 0;
+}
+
+int board_fits(const board *board, const uint8_t shape_rows[MATRIX_SIZE], int x, int y)
+{
+    int shift = x + BOARD_WALL;
+    if (shift < 0 || shift > 32 - MATRIX_SIZE)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < MATRIX_SIZE; i++)
+    {
+        int row = y + i;
+        if (!shape_rows[i] || row < 0)
+        {
+            continue;
+        }
+
+        if (row >= GRID_CELL_HEIGHT || ((uint32_t)shape_rows[i] << shift) & board->rows[row])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void board_place(board *board, const uint8_t shape_rows[MATRIX_SIZE], int x, int y, int color)
+{
+    for (int i = 0; i < MATRIX_SIZE; i++)
+    {
+        int row = y + i;
+        if (!shape_rows[i] || row < 0 || row >= GRID_CELL_HEIGHT)
+        {
+            continue;
+        }
+
+        uint32_t cells = (uint32_t)shape_rows[i] << (x + BOARD_WALL);
+        board->rows[row] |= cells;
+        board->hash ^= zobrist_cells(row, cells);
+        for (int j = 0; j < MATRIX_SIZE; j++)
+        {
+            if (shape_rows[i] & (1 << j))
+            {
+                board->colors[row][x + j] = color;
+            }
+        }
+    }
+}
+
+/**
+ * Gets the combined key of the cells in the rows from the top of the board down to the given row
+ */
+static uint64_t hash_rows(const board *board, int bottom)
+{
+    uint64_t hash = 0;
+    for (int row = 0; row <= bottom; row++)
+    {
+        hash ^= zobrist_cells(row, board->rows[row]);
+    }
+
+    return hash;
+}
+
+int board_clear_full_rows(board *board, int top, int count)
+{
+    int full[GRID_CELL_HEIGHT];
+    int num_full = 0;
+    for (int row = top < 0 ? 0 : top; row < top + count && row < GRID_CELL_HEIGHT; row++)
+    {
+        if (board->rows[row] == BOARD_FULL_ROW)
+        {
+            full[num_full++] = row;
+        }
+    }
+
+    if (!num_full)
+    {
+        return 0;
+    }
+
+    // Every row down to the lowest full one changes, so swap their keys out and back in afterwards
+    int bottom = full[num_full - 1];
+    board->hash ^= hash_rows(board, bottom);
+
+    // Working up from the lowest full row, each block of rows between full rows
+    // moves down by the number of full rows beneath it
+    for (int i = num_full - 1; i >= 0; i--)
+    {
+        int start = i > 0 ? full[i - 1] + 1 : 0;
+        int length = full[i] - start;
+        int shift = num_full - i;
+        memmove(&board->rows[start + shift], &board->rows[start], length * sizeof(board->rows[0]));
+        memmove(&board->colors[start + shift], &board->colors[start], length * sizeof(board->colors[0]));
+    }
+
+    // Clear out the rows left empty at the top
+    for (int row = 0; row < num_full; row++)
+    {
+        board->rows[row] = BOARD_EMPTY_ROW;
+    }
+
+    memset(board->colors, 0, num_full * sizeof(board->colors[0]));
+    board->hash ^= hash_rows(board, bottom);
+
+    return num_full;
+}
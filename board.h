@@ -0,0 +1,63 @@
+/**
+ * Bitboard representation of the play area
+ */
+#pragma once
+
+#include <stdint.h>
+#include "tetronimoes.h"
+
+#define GRID_CELL_WIDTH 12
+#define GRID_CELL_HEIGHT 18
+
+// Each row is a single word with the play area columns stored from bit BOARD_WALL
+// upwards. Every bit outside of the play area is set so the walls collide like any
+// other filled cell and a full row is simply all ones.
+#define BOARD_WALL 4
+#define BOARD_FULL_ROW 0xFFFFFFFFu
+#define BOARD_EMPTY_ROW (~(((1u << GRID_CELL_WIDTH) - 1) << BOARD_WALL))
+
+/**
+ * The play area. Occupancy is held one word per row for the game rules,
+ * colors are held separately and only used for rendering. The Zobrist hash of
+ * the occupied cells is kept up to date as cells are filled and rows cleared.
+ */
+typedef struct board
+{
+    uint32_t rows[GRID_CELL_HEIGHT];                   // occupied cells, bit BOARD_WALL + n is column n
+    uint8_t colors[GRID_CELL_HEIGHT][GRID_CELL_WIDTH]; // color of each occupied cell
+    uint64_t hash;                                     // Zobrist hash of the occupied cells, colors aren't included
+} board;
+
+/**
+ * Empties the board.
+ */
+void board_clear(board *board);
+
+/**
+ * Checks to see if a shape fits in the play area at the given grid position
+ * without overlapping any filled cells.
+ *
+ * @param board      the board to check against
+ * @param shape_rows row bitmasks of the shape, bit n set for matrix column n
+ * @param x          grid column of the shape's left matrix column
+ * @param y          grid row of the shape's top matrix row
+ * @returns          1 if the shape fits, 0 otherwise
+ */
+int board_fits(const board *board, const uint8_t shape_rows[MATRIX_SIZE], int x, int y);
+
+/**
+ * Fills the cells of a shape in the board. The position must be one that fits.
+ */
+void board_place(board *board, const uint8_t shape_rows[MATRIX_SIZE], int x, int y, int color);
+
+/**
+ * Removes all of the full rows in a range, typically the rows covered by a
+ * shape that has just been placed, and shifts everything above them down.
+ * The board is compacted in a single pass however many rows are removed.
+ *
+ * @param board the board to update
+ * @param top   the first row to check
+ * @param count the number of rows to check
+ * @returns     the number of rows removed
+ */
+int board_clear_full_rows(board *board, int top, int count);
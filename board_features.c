@@ -0,0 +1,181 @@
+/**
+ * Feature extraction. The rows of several boards are processed side by side,
+ * one board per SIMD lane, and every feature is built from AND, OR, XOR and
+ * shifts of whole rows. Per column counts such as the heights are kept as
+ * bit-sliced counters: plane k of a counter holds bit k of every column's
+ * count, so adding a row of ones to twelve counters takes a handful of
+ * instructions and the totals need only a few popcounts at the end.
+ *
+ * x86 builds that don't already target AVX2 build an AVX2 kernel alongside
+ * the SSE2 one and pick between them at runtime.
+ */
+
+#include <stdlib.h>
+
+#include "board_features.h"
+
+#define PLAY_AREA (~BOARD_EMPTY_ROW)
+
+// Boundaries between neighbouring cells along a row, from the left wall to the right wall
+#define ROW_BOUNDARIES (((1u << (GRID_CELL_WIDTH + 1)) - 1) << (BOARD_WALL - 1))
+
+// The masks being counted only use the low half of a row, so two are counted
+// at once with the second shifted into the high half
+#define HIGH_HALF 16
+
+// Bits needed for a count of up to GRID_CELL_HEIGHT, and for a well sum of up to 1 + 2 + ... + GRID_CELL_HEIGHT
+#define COUNT_BITS 5
+#define SUM_BITS 8
+
+#if !defined(__AVX2__) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DISPATCH_AVX2
+#endif
+
+#if defined(__AVX2__) || defined(DISPATCH_AVX2)
+#include <immintrin.h>
+#define vec __m256i
+#define LANES 8
+#define VAND(a, b) _mm256_and_si256(a, b)
+#define VOR(a, b) _mm256_or_si256(a, b)
+#define VXOR(a, b) _mm256_xor_si256(a, b)
+#define VANDNOT(a, b) _mm256_andnot_si256(b, a)
+#define VADD(a, b) _mm256_add_epi32(a, b)
+#define VSUB(a, b) _mm256_sub_epi32(a, b)
+#define VSHL(a, n) _mm256_slli_epi32(a, n)
+#define VSHR(a, n) _mm256_srli_epi32(a, n)
+#define VSRA(a, n) _mm256_srai_epi32(a, n)
+#define VSET1(x) _mm256_set1_epi32((int)(x))
+#define VSTORE(p, a) _mm256_storeu_si256((__m256i *)(p), a)
+#define VMAKE8(a, b, c, d, e, f, g, h) _mm256_setr_epi32(a, b, c, d, e, f, g, h)
+#ifdef DISPATCH_AVX2
+#define KERNEL(name) name##_avx2
+#define KERNEL_ATTR __attribute__((target("avx2")))
+#else
+#define KERNEL(name) name
+#define KERNEL_ATTR
+#endif
+#include "board_features_kernel.h"
+#endif
+
+#if !defined(__AVX2__)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define vec __m128i
+#define LANES 4
+#define VAND(a, b) _mm_and_si128(a, b)
+#define VOR(a, b) _mm_or_si128(a, b)
+#define VXOR(a, b) _mm_xor_si128(a, b)
+#define VANDNOT(a, b) _mm_andnot_si128(b, a)
+#define VADD(a, b) _mm_add_epi32(a, b)
+#define VSUB(a, b) _mm_sub_epi32(a, b)
+#define VSHL(a, n) _mm_slli_epi32(a, n)
+#define VSHR(a, n) _mm_srli_epi32(a, n)
+#define VSRA(a, n) _mm_srai_epi32(a, n)
+#define VSET1(x) _mm_set1_epi32((int)(x))
+#define VSTORE(p, a) _mm_storeu_si128((__m128i *)(p), a)
+#define VMAKE4(a, b, c, d) _mm_setr_epi32(a, b, c, d)
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define vec v128_t
+#define LANES 4
+#define VAND(a, b) wasm_v128_and(a, b)
+#define VOR(a, b) wasm_v128_or(a, b)
+#define VXOR(a, b) wasm_v128_xor(a, b)
+#define VANDNOT(a, b) wasm_v128_andnot(a, b)
+#define VADD(a, b) wasm_i32x4_add(a, b)
+#define VSUB(a, b) wasm_i32x4_sub(a, b)
+#define VSHL(a, n) wasm_i32x4_shl(a, n)
+#define VSHR(a, n) wasm_u32x4_shr(a, n)
+#define VSRA(a, n) wasm_i32x4_shr(a, n)
+#define VSET1(x) wasm_i32x4_splat((int)(x))
+#define VSTORE(p, a) wasm_v128_store(p, a)
+#define VMAKE4(a, b, c, d) wasm_i32x4_make(a, b, c, d)
+#else
+#define vec uint32_t
+#define LANES 1
+#define VAND(a, b) ((a) & (b))
+#define VOR(a, b) ((a) | (b))
+#define VXOR(a, b) ((a) ^ (b))
+#define VANDNOT(a, b) ((a) & ~(b))
+#define VADD(a, b) ((a) + (b))
+#define VSUB(a, b) ((a) - (b))
+#define VSHL(a, n) ((a) << (n))
+#define VSHR(a, n) ((a) >> (n))
+#define VSRA(a, n) ((uint32_t)((int32_t)(a) >> (n)))
+#define VSET1(x) ((uint32_t)(x))
+#define VSTORE(p, a) (*(p) = (a))
+#endif
+#define KERNEL(name) name
+#define KERNEL_ATTR
+#include "board_features_kernel.h"
+#endif
+
+void extract_features(const board *board, board_features *features)
+{
+    extract_features_batch(board, 1, features);
+}
+
+void extract_features_batch(const board *boards, int count, board_features *features)
+{
+#ifdef DISPATCH_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        extract_batch_avx2(boards, count, features);
+        return;
+    }
+#endif
+
+    extract_batch(boards, count, features);
+}
+
+/**
+ * @returns 1 if the cell is filled, columns -1 and GRID_CELL_WIDTH being the walls
+ */
+static int is_filled(const board *board, int row, int col)
+{
+    return (board->rows[row] >> (BOARD_WALL + col)) & 1;
+}
+
+void extract_features_reference(const board *board, board_features *features)
+{
+    *features = (board_features){ 0 };
+    for (int col = 0; col < GRID_CELL_WIDTH; col++)
+    {
+        int depth = 0;
+        for (int row = 0; row < GRID_CELL_HEIGHT; row++)
+        {
+            int filled = is_filled(board, row, col);
+            if (filled && !features->heights[col])
+            {
+                features->heights[col] = GRID_CELL_HEIGHT - row;
+            }
+            else if (!filled && features->heights[col])
+            {
+                features->holes++;
+            }
+
+            if (row > 0 && filled != is_filled(board, row - 1, col))
+            {
+                features->column_transitions++;
+            }
+
+            depth = !filled && is_filled(board, row, col - 1) && is_filled(board, row, col + 1) ? depth + 1 : 0;
+            features->well_sums += depth;
+        }
+
+        features->column_transitions += !is_filled(board, GRID_CELL_HEIGHT - 1, col);
+        features->aggregate_height += features->heights[col];
+        if (col > 0)
+        {
+            features->bumpiness += abs(features->heights[col] - features->heights[col - 1]);
+        }
+    }
+
+    for (int row = 0; row < GRID_CELL_HEIGHT; row++)
+    {
+        for (int col = -1; col < GRID_CELL_WIDTH; col++)
+        {
+            features->row_transitions += is_filled(board, row, col) != is_filled(board, row, col + 1);
+        }
+    }
+}
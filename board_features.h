@@ -0,0 +1,43 @@
+/**
+ * Board features used to score positions, e.g. by the bot
+ */
+#pragma once
+
+#include "board.h"
+
+/**
+ * Measurements of a board. Heights count from the bottom of the board to the
+ * highest filled cell in the column.
+ */
+typedef struct board_features
+{
+    int heights[GRID_CELL_WIDTH];
+    int aggregate_height;    // sum of the column heights
+    int bumpiness;           // sum of the height differences between neighbouring columns
+    int holes;               // empty cells with a filled cell somewhere above them
+    int row_transitions;     // changes between filled and empty along each row, the walls count as filled
+    int column_transitions;  // changes between filled and empty down each column, the floor counts as filled
+    int well_sums;           // each run of empty cells with filled cells either side scores 1 + 2 + ... + depth
+} board_features;
+
+/**
+ * Measures a single board.
+ */
+void extract_features(const board *board, board_features *features);
+
+/**
+ * Measures a number of boards at once. Boards are processed several at a time
+ * using SIMD where the target supports it, so this is much faster per board
+ * than calling extract_features for each.
+ *
+ * @param boards   the boards to measure
+ * @param count    the number of boards
+ * @param features receives the features of each board
+ */
+void extract_features_batch(const board *boards, int count, board_features *features);
+
+/**
+ * Measures a single board a cell at a time, straight from the definitions
+ * above. Slow, it is there to check the SIMD kernels against.
+ */
+void extract_features_reference(const board *board, board_features *features);
@@ -0,0 +1,211 @@
+/**
+ * The feature extraction kernel, written once against the vector operations
+ * defined by board_features.c and included there once for each instruction
+ * set built. Expects vec, LANES, the V macros, KERNEL(name) to give each
+ * function a name of its own and KERNEL_ATTR for any target attribute.
+ */
+
+/**
+ * Adds one to every counter whose bit is set in the mask
+ */
+static inline KERNEL_ATTR void KERNEL(increment)(vec *planes, int bits, vec mask)
+{
+    for (int k = 0; k < bits; k++)
+    {
+        vec carry = VAND(planes[k], mask);
+        planes[k] = VXOR(planes[k], mask);
+        mask = carry;
+    }
+}
+
+/**
+ * Counts the bits set in each half of each lane, giving the low half's count
+ * in the low half of the result and the high half's count in the high half
+ */
+static inline KERNEL_ATTR vec KERNEL(count_halves)(vec v)
+{
+    v = VSUB(v, VAND(VSHR(v, 1), VSET1(0x55555555)));
+    v = VADD(VAND(v, VSET1(0x33333333)), VAND(VSHR(v, 2), VSET1(0x33333333)));
+    v = VAND(VADD(v, VSHR(v, 4)), VSET1(0x0F0F0F0F));
+    return VAND(VADD(v, VSHR(v, 8)), VSET1(0x00FF00FF));
+}
+
+/**
+ * Sums a bit-sliced counter across all of the columns, separately for each half of each lane
+ */
+static inline KERNEL_ATTR vec KERNEL(total)(const vec *planes, int bits)
+{
+    vec sum = VSET1(0);
+    for (int k = 0; k < bits; k++)
+    {
+        sum = VADD(sum, VSHL(KERNEL(count_halves)(planes[k]), k));
+    }
+
+    return sum;
+}
+
+/**
+ * Loads the same row from each of a group of boards, repeating the last board
+ * in any lanes past the end
+ */
+static inline KERNEL_ATTR vec KERNEL(load_rows)(const board *boards, int count, int row)
+{
+#if LANES == 8
+    int last = count - 1;
+    return VMAKE8(boards[0].rows[row], boards[last < 1 ? last : 1].rows[row], boards[last < 2 ? last : 2].rows[row],
+                  boards[last < 3 ? last : 3].rows[row], boards[last < 4 ? last : 4].rows[row],
+                  boards[last < 5 ? last : 5].rows[row], boards[last < 6 ? last : 6].rows[row],
+                  boards[last < 7 ? last : 7].rows[row]);
+#elif LANES == 4
+    int last = count - 1;
+    return VMAKE4(boards[0].rows[row], boards[last < 1 ? last : 1].rows[row], boards[last < 2 ? last : 2].rows[row],
+                  boards[last < 3 ? last : 3].rows[row]);
+#else
+    (void)count;
+    return boards[0].rows[row];
+#endif
+}
+
+/**
+ * Measures up to LANES boards at once
+ */
+static KERNEL_ATTR void KERNEL(extract_group)(const board *boards, int count, board_features *features)
+{
+    const vec play_area = VSET1(PLAY_AREA);
+    const vec row_boundaries = VSET1(ROW_BOUNDARIES);
+
+    // Holes in the low half and covered cells, which make up the heights, in the high half
+    vec holes_heights[COUNT_BITS];
+
+    // Row transitions in the low half and column transitions in the high half
+    vec transitions[COUNT_BITS];
+
+    vec well_depths[COUNT_BITS], well_sums[SUM_BITS];
+    for (int k = 0; k < SUM_BITS; k++)
+    {
+        if (k < COUNT_BITS)
+        {
+            holes_heights[k] = transitions[k] = well_depths[k] = VSET1(0);
+        }
+
+        well_sums[k] = VSET1(0);
+    }
+
+    vec covered = VSET1(0);
+    vec above = KERNEL(load_rows)(boards, count, 0);
+    for (int row = 0; row < GRID_CELL_HEIGHT; row++)
+    {
+        vec rows = KERNEL(load_rows)(boards, count, row);
+        vec cells = VAND(rows, play_area);
+
+        // Every cell at or below the top of its column adds one to the column's height,
+        // the empty ones are holes
+        covered = VOR(covered, cells);
+        KERNEL(increment)(holes_heights, COUNT_BITS, VOR(VANDNOT(covered, cells), VSHL(covered, HIGH_HALF)));
+
+        vec row_changes = VAND(VXOR(rows, VSHR(rows, 1)), row_boundaries);
+        vec column_changes = VAND(VXOR(rows, above), play_area);
+        KERNEL(increment)(transitions, COUNT_BITS, VOR(row_changes, VSHL(column_changes, HIGH_HALF)));
+        above = rows;
+
+        // Extend the wells that carry on down, start new ones and drop the rest
+        vec wells = VANDNOT(VAND(VAND(VSHL(rows, 1), VSHR(rows, 1)), play_area), rows);
+        for (int k = 0; k < COUNT_BITS; k++)
+        {
+            well_depths[k] = VAND(well_depths[k], wells);
+        }
+
+        KERNEL(increment)(well_depths, COUNT_BITS, wells);
+
+        // Add each well's depth so far to its column's running sum
+        vec carry = VSET1(0);
+        for (int k = 0; k < SUM_BITS; k++)
+        {
+            vec depth = k < COUNT_BITS ? well_depths[k] : VSET1(0);
+            vec half = VXOR(well_sums[k], depth);
+            vec next = VOR(VAND(well_sums[k], depth), VAND(carry, half));
+            well_sums[k] = VXOR(half, carry);
+            carry = next;
+        }
+    }
+
+    // The floor counts as filled
+    vec floor = VANDNOT(play_area, above);
+    KERNEL(increment)(transitions, COUNT_BITS, VSHL(floor, HIGH_HALF));
+
+    // Read each column's height out of the counter, then compare neighbours
+    vec heights[GRID_CELL_WIDTH];
+    vec bumpiness = VSET1(0);
+    for (int col = 0; col < GRID_CELL_WIDTH; col++)
+    {
+        heights[col] = VSET1(0);
+        for (int k = 0; k < COUNT_BITS; k++)
+        {
+            vec bit = VAND(VSHR(holes_heights[k], HIGH_HALF + BOARD_WALL + col), VSET1(1));
+            heights[col] = VOR(heights[col], VSHL(bit, k));
+        }
+
+        if (col > 0)
+        {
+            vec step = VSUB(heights[col], heights[col - 1]);
+            vec sign = VSRA(step, 31);
+            bumpiness = VADD(bumpiness, VSUB(VXOR(step, sign), sign));
+        }
+    }
+
+    uint32_t holes_heights_totals[LANES], transition_totals[LANES], well_totals[LANES];
+    uint32_t bumpiness_totals[LANES], column_heights[GRID_CELL_WIDTH][LANES];
+    VSTORE(holes_heights_totals, KERNEL(total)(holes_heights, COUNT_BITS));
+    VSTORE(transition_totals, KERNEL(total)(transitions, COUNT_BITS));
+    VSTORE(well_totals, KERNEL(total)(well_sums, SUM_BITS));
+    VSTORE(bumpiness_totals, bumpiness);
+    for (int col = 0; col < GRID_CELL_WIDTH; col++)
+    {
+        VSTORE(column_heights[col], heights[col]);
+    }
+
+    for (int lane = 0; lane < count && lane < LANES; lane++)
+    {
+        board_features *f = &features[lane];
+        for (int col = 0; col < GRID_CELL_WIDTH; col++)
+        {
+            f->heights[col] = column_heights[col][lane];
+        }
+
+        f->aggregate_height = holes_heights_totals[lane] >> HIGH_HALF;
+        f->bumpiness = bumpiness_totals[lane];
+        f->holes = holes_heights_totals[lane] & 0xFFFF;
+        f->row_transitions = transition_totals[lane] & 0xFFFF;
+        f->column_transitions = transition_totals[lane] >> HIGH_HALF;
+        f->well_sums = well_totals[lane] & 0xFFFF;
+    }
+}
+
+/**
+ * Measures any number of boards, LANES at a time
+ */
+static KERNEL_ATTR void KERNEL(extract_batch)(const board *boards, int count, board_features *features)
+{
+    for (int i = 0; i < count; i += LANES)
+    {
+        KERNEL(extract_group)(boards + i, count - i, features + i);
+    }
+}
+
+#undef vec
+#undef LANES
+#undef VAND
+#undef VOR
+#undef VXOR
+#undef VANDNOT
+#undef VADD
+#undef VSUB
+#undef VSHL
+#undef VSHR
+#undef VSRA
+#undef VSET1
+#undef VSTORE
+#undef VMAKE4
+#undef VMAKE8
+#undef KERNEL
+#undef KERNEL_ATTR
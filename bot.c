@@ -0,0 +1,315 @@
+/**
+ * Placement search for autoplay. Each candidate is locked into a copy of the
+ * board, then the resulting boards are measured together and scored on their
+ * height, bumpiness, holes and lines cleared. Given a transposition table, the
+ * placements found for a position and the measurements of each board are
+ * cached under their Zobrist hashes.
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "board_features.h"
+#include "bot.h"
+#include "zobrist.h"
+
+#define MAX_PLACEMENTS (NUM_DIRECTIONS * (GRID_CELL_WIDTH + MATRIX_SIZE))
+
+// Heuristic weights, from a genetic search over the same four features
+#define HEIGHT_WEIGHT -0.510066f
+#define LINES_WEIGHT 0.760666f
+#define HOLES_WEIGHT -0.35663f
+#define BUMPINESS_WEIGHT -0.184483f
+
+// Cached placement sets hold four placements to a word after the count
+#define MAX_CACHED_PLACEMENTS ((TT_PLACEMENT_WORDS - 1) * 4)
+
+// Keeps board measurements apart from anything else cached under a board's hash
+#define FEATURES_KEY 0x9E3779B97F4A7C15ULL
+
+/**
+ * Adds every column the tetronimo can slide to in one direction, dropped as far as it goes
+ */
+static int add_slides(const board *board, int piece, direction direction, int rotations, int x, int y, int step,
+                      placement *placements)
+{
+    const tetronimo *tetronimo = get_tetronimo(piece, direction);
+    int count = 0;
+    for (; board_fits(board, tetronimo->rows, x, y); x += step)
+    {
+        int bottom = y;
+        while (board_fits(board, tetronimo->rows, x, bottom + 1))
+        {
+            bottom++;
+        }
+
+        placements[count++] = (placement){ direction, x, bottom, rotations };
+    }
+
+    return count;
+}
+
+/**
+ * Finds every placement reachable by rotating at the starting position, then
+ * sliding and dropping
+ *
+ * @returns the number of placements
+ */
+static int find_placements(const board *board, int piece, direction start, int x, int y, placement *placements)
+{
+    int count = 0;
+    int seen[NUM_DIRECTIONS] = { 0 };
+
+    // Quarter turns clockwise first, then anticlockwise for any direction not yet reached
+    static const int turns[] = { 0, 1, 2, 3, -1, -2 };
+    for (size_t i = 0; i < sizeof(turns) / sizeof(turns[0]); i++)
+    {
+        int rotations = turns[i];
+        direction direction = start;
+        int reachable = 1;
+        for (int j = 0; j < (rotations < 0 ? -rotations : rotations) && reachable; j++)
+        {
+            direction = rotate(piece, direction, rotations < 0 ? TWO_SEVENTY_DEGREES : NINETY_DEGREES);
+            reachable = board_fits(board, get_tetronimo(piece, direction)->rows, x, y);
+        }
+
+        if (!reachable || seen[direction])
+        {
+            continue;
+        }
+
+        seen[direction] = 1;
+        count += add_slides(board, piece, direction, rotations, x, y, -1, placements + count);
+        count += add_slides(board, piece, direction, rotations, x + 1, y, 1, placements + count);
+    }
+
+    return count;
+}
+
+/**
+ * Scores a board, higher is better
+ */
+static float evaluate(const board_features *features, int lines)
+{
+    return HEIGHT_WEIGHT * features->aggregate_height + LINES_WEIGHT * lines + HOLES_WEIGHT * features->holes +
+           BUMPINESS_WEIGHT * features->bumpiness;
+}
+
+/**
+ * Packs a placement into 16 bits: the row, column, direction and rotations
+ */
+static uint64_t pack_placement(const placement *placement)
+{
+    return placement->y | (placement->x + MATRIX_SIZE) << 5 | placement->direction << 9 |
+           (placement->rotations + 2) << 11;
+}
+
+static placement unpack_placement(uint64_t packed)
+{
+    return (placement){ (packed >> 9) & 3, (int)((packed >> 5) & 15) - MATRIX_SIZE, packed & 31,
+                        (int)((packed >> 11) & 7) - 2 };
+}
+
+/**
+ * Finds the placements for a position, from the transposition table if it has been seen before
+ */
+static int find_placements_cached(transposition_table *table, const board *board, int piece, direction start, int x,
+                                  int y, placement *placements)
+{
+    if (!table)
+    {
+        return find_placements(board, piece, start, x, y, placements);
+    }
+
+    uint64_t key = board->hash ^ zobrist_shape(piece, start, x, y);
+    uint64_t words[TT_PLACEMENT_WORDS];
+    if (probe_placements(table, key, words))
+    {
+        int count = words[0];
+        for (int i = 0; i < count; i++)
+        {
+            placements[i] = unpack_placement(words[1 + i / 4] >> (i % 4 * 16));
+        }
+
+        return count;
+    }
+
+    int count = find_placements(board, piece, start, x, y, placements);
+    if (count <= MAX_CACHED_PLACEMENTS)
+    {
+        memset(words, 0, sizeof(words));
+        words[0] = count;
+        for (int i = 0; i < count; i++)
+        {
+            words[1 + i / 4] |= pack_placement(&placements[i]) << (i % 4 * 16);
+        }
+
+        store_placements(table, key, words);
+    }
+
+    return count;
+}
+
+/**
+ * Measures each board, taking any that have been seen before from the
+ * transposition table. Only the measurements used by evaluate are cached.
+ * The boards are overwritten.
+ */
+static void measure_boards(transposition_table *table, board *boards, int count, board_features *features)
+{
+    if (!table)
+    {
+        extract_features_batch(boards, count, features);
+        return;
+    }
+
+    // Move the boards that weren't found to the front so they can be measured together
+    int unseen[MAX_PLACEMENTS];
+    int num_unseen = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t packed;
+        if (probe_score(table, boards[i].hash ^ FEATURES_KEY, &packed))
+        {
+            features[i].aggregate_height = packed & 0xFFFF;
+            features[i].holes = (packed >> 16) & 0xFFFF;
+            features[i].bumpiness = (packed >> 32) & 0xFFFF;
+            continue;
+        }
+
+        if (num_unseen != i)
+        {
+            boards[num_unseen] = boards[i];
+        }
+
+        unseen[num_unseen++] = i;
+    }
+
+    board_features measured[MAX_PLACEMENTS];
+    extract_features_batch(boards, num_unseen, measured);
+    for (int i = 0; i < num_unseen; i++)
+    {
+        board_features *f = &measured[i];
+        features[unseen[i]] = *f;
+        store_score(table, boards[i].hash ^ FEATURES_KEY,
+                    f->aggregate_height | (uint64_t)f->holes << 16 | (uint64_t)f->bumpiness << 32);
+    }
+}
+
+/**
+ * Locks a tetronimo into a board, removing any rows it completes
+ *
+ * @returns the number of rows removed
+ */
+static int lock(board *board, int piece, const placement *placement)
+{
+    const tetronimo *tetronimo = get_tetronimo(piece, placement->direction);
+    board_place(board, tetronimo->rows, placement->x, placement->y, 0);
+    return board_clear_full_rows(board, placement->y + tetronimo->top, tetronimo->bottom - tetronimo->top + 1);
+}
+
+/**
+ * Locks a tetronimo into a copy of the board at each placement
+ *
+ * @param boards receives the resulting boards
+ * @param lines  receives the number of rows each placement clears
+ */
+static void lock_placements(const board *board, int piece, const placement *placements, int count, struct board *boards,
+                            int *lines)
+{
+    for (int i = 0; i < count; i++)
+    {
+        boards[i] = *board;
+        lines[i] = lock(&boards[i], piece, &placements[i]);
+    }
+}
+
+/**
+ * Scores the best placement of a tetronimo spawned on a board
+ */
+static float best_score(transposition_table *table, const board *board, int piece, int lines)
+{
+    placement placements[MAX_PLACEMENTS];
+    struct board boards[MAX_PLACEMENTS];
+    board_features features[MAX_PLACEMENTS];
+    int cleared[MAX_PLACEMENTS];
+    int count = find_placements_cached(table, board, piece, UP, SPAWN_X, SPAWN_Y, placements);
+    lock_placements(board, piece, placements, count, boards, cleared);
+    measure_boards(table, boards, count, features);
+
+    float best = -FLT_MAX;
+    for (int i = 0; i < count; i++)
+    {
+        float score = evaluate(&features[i], lines + cleared[i]);
+        if (score > best)
+        {
+            best = score;
+        }
+    }
+
+    return best;
+}
+
+int bot_choose(const engine *engine, int lookahead, transposition_table *table, placement *placement)
+{
+    const shape *shape = &engine->shape;
+    struct placement placements[MAX_PLACEMENTS];
+    board boards[MAX_PLACEMENTS];
+    board_features features[MAX_PLACEMENTS];
+    int cleared[MAX_PLACEMENTS];
+    int count = find_placements_cached(table, &engine->board, shape->piece, shape->direction, shape->x, shape->y,
+                                       placements);
+    lock_placements(&engine->board, shape->piece, placements, count, boards, cleared);
+    if (!lookahead)
+    {
+        measure_boards(table, boards, count, features);
+    }
+
+    float best = -FLT_MAX;
+    for (int i = 0; i < count; i++)
+    {
+        float score = lookahead ? best_score(table, &boards[i], engine_peek(engine, 0), cleared[i])
+                                : evaluate(&features[i], cleared[i]);
+        if (score > best || i == 0)
+        {
+            best = score;
+            *placement = placements[i];
+        }
+    }
+
+    return count > 0;
+}
+
+engine_action bot_next_action(const engine *engine, const placement *placement)
+{
+    const shape *shape = &engine->shape;
+    if (shape->direction != placement->direction)
+    {
+        return placement->rotations < 0 ? ACTION_ROTATE_CCW : ACTION_ROTATE_CW;
+    }
+
+    if (shape->x != placement->x)
+    {
+        return shape->x > placement->x ? ACTION_LEFT : ACTION_RIGHT;
+    }
+
+    return ACTION_DROP;
+}
+
+int bot_play(engine *engine, const placement *placement)
+{
+    int events = 0;
+    while (!(events & EVENT_LOCKED) && engine->state.action == RUNNING)
+    {
+        engine_action action = bot_next_action(engine, placement);
+        int result = engine_step(engine, action);
+        if (!result)
+        {
+            result = engine_step(engine, ACTION_DROP);
+        }
+
+        events |= result;
+    }
+
+    return events;
+}
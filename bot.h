@@ -0,0 +1,46 @@
+/**
+ * Autoplay. Picks where each new shape should go and the actions to get it there.
+ */
+#pragma once
+
+#include "engine.h"
+#include "transposition.h"
+
+/**
+ * Where a shape will be locked, and how to get it there from where it started
+ */
+typedef struct placement
+{
+    direction direction; // final orientation
+    int x;               // final grid column
+    int y;               // final grid row, where the shape lands
+    int rotations;       // number of quarter turns, positive clockwise
+} placement;
+
+/**
+ * Searches every orientation and column the in-play shape can reach by
+ * rotating where it is, sliding sideways and dropping, and picks the one
+ * that leaves the best board.
+ *
+ * @param engine    the game, the shape should be where it was spawned
+ * @param lookahead 1 to also consider where the next tetronimo could go
+ * @param table     caches placements and board measurements between calls, may be 0. May be
+ *                  shared by any number of threads.
+ * @param placement receives the chosen placement
+ * @returns         1 if a placement was found, 0 if the shape cannot move
+ */
+int bot_choose(const engine *engine, int lookahead, transposition_table *table, placement *placement);
+
+/**
+ * Gets the next action to move the in-play shape towards a placement,
+ * rotating first, then sliding, then dropping.
+ */
+engine_action bot_next_action(const engine *engine, const placement *placement);
+
+/**
+ * Applies every action needed to lock the in-play shape at a placement. If
+ * the shape gets stuck on the way it is dropped where it is.
+ *
+ * @returns the combined engine_event flags of the actions
+ */
+int bot_play(engine *engine, const placement *placement);
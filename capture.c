@@ -0,0 +1,196 @@
+/**
+ * Frame capture with a small queue of preallocated buffers shared between the
+ * frame loop and an encoder thread
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include "arena.h"
+#include "capture.h"
+
+#define CAPTURE_BUFFERS 8
+
+struct capture
+{
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *changed;                   // signalled when a frame is queued or saved
+    char pattern[256];
+    int png;                             // save as PNG rather than PPM
+    int width;
+    int height;
+    uint8_t *buffers[CAPTURE_BUFFERS];
+    int frame_numbers[CAPTURE_BUFFERS];
+    int head;                            // oldest queued frame
+    int count;                           // number of queued frames
+    int next_frame;
+    int quit;
+};
+
+static void save_ppm(const char *path, const uint8_t *pixels, int width, int height)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    fwrite(pixels, 3, (size_t)width * height, file);
+    fclose(file);
+}
+
+static void save_png(const char *path, uint8_t *pixels, int width, int height)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, width, height, 24, width * 3,
+                                                              SDL_PIXELFORMAT_RGB24);
+    if (!surface || IMG_SavePNG(surface, path))
+    {
+        fprintf(stderr, "Unable to save %s. SDL_image Error: %s\n", path, IMG_GetError());
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+/**
+ * Encoder thread. Saves queued frames until asked to quit and the queue is empty.
+ */
+static int encode_frames(void *data)
+{
+    capture *capture = data;
+    char path[512];
+
+    // Encoding allocates, but off the frame loop where it does no harm
+    untrack_thread_allocations();
+
+    SDL_LockMutex(capture->lock);
+    for (;;)
+    {
+        while (!capture->count && !capture->quit)
+        {
+            SDL_CondWait(capture->changed, capture->lock);
+        }
+
+        if (!capture->count)
+        {
+            break;
+        }
+
+        // The frame loop never touches a queued buffer so it can be encoded unlocked
+        int slot = capture->head;
+        SDL_UnlockMutex(capture->lock);
+
+        snprintf(path, sizeof(path), capture->pattern, capture->frame_numbers[slot]);
+        if (capture->png)
+        {
+            save_png(path, capture->buffers[slot], capture->width, capture->height);
+        }
+        else
+        {
+            save_ppm(path, capture->buffers[slot], capture->width, capture->height);
+        }
+
+        SDL_LockMutex(capture->lock);
+        capture->head = (capture->head + 1) % CAPTURE_BUFFERS;
+        capture->count--;
+        SDL_CondSignal(capture->changed);
+    }
+
+    SDL_UnlockMutex(capture->lock);
+    return 0;
+}
+
+capture *open_capture(const char *pattern, int width, int height)
+{
+    capture *capture = SDL_calloc(1, sizeof(struct capture));
+    if (!capture)
+    {
+        fprintf(stderr, "Unable to allocate frame capture\n");
+        return 0;
+    }
+
+    snprintf(capture->pattern, sizeof(capture->pattern), "%s", pattern);
+    size_t length = strlen(pattern);
+    capture->png = length > 4 && !strcmp(pattern + length - 4, ".png");
+    capture->width = width;
+    capture->height = height;
+    for (int i = 0; i < CAPTURE_BUFFERS; i++)
+    {
+        capture->buffers[i] = SDL_malloc((size_t)width * height * 3);
+        if (!capture->buffers[i])
+        {
+            fprintf(stderr, "Unable to allocate frame capture buffers\n");
+            close_capture(capture);
+            return 0;
+        }
+    }
+
+    capture->lock = SDL_CreateMutex();
+    capture->changed = SDL_CreateCond();
+    if (!capture->lock || !capture->changed)
+    {
+        fprintf(stderr, "Unable to create capture queue. SDL Error: %s\n", SDL_GetError());
+        close_capture(capture);
+        return 0;
+    }
+
+    capture->thread = SDL_CreateThread(encode_frames, "capture", capture);
+    if (!capture->thread)
+    {
+        fprintf(stderr, "Unable to start capture thread. SDL Error: %s\n", SDL_GetError());
+        capture->quit = 1;
+        close_capture(capture);
+        return 0;
+    }
+
+    return capture;
+}
+
+uint8_t *get_capture_buffer(capture *capture)
+{
+    SDL_LockMutex(capture->lock);
+    while (capture->count == CAPTURE_BUFFERS)
+    {
+        SDL_CondWait(capture->changed, capture->lock);
+    }
+
+    int slot = (capture->head + capture->count) % CAPTURE_BUFFERS;
+    SDL_UnlockMutex(capture->lock);
+
+    return capture->buffers[slot];
+}
+
+void submit_capture_buffer(capture *capture)
+{
+    SDL_LockMutex(capture->lock);
+    int slot = (capture->head + capture->count) % CAPTURE_BUFFERS;
+    capture->frame_numbers[slot] = capture->next_frame++;
+    capture->count++;
+    SDL_CondSignal(capture->changed);
+    SDL_UnlockMutex(capture->lock);
+}
+
+void close_capture(capture *capture)
+{
+    if (capture->thread)
+    {
+        SDL_LockMutex(capture->lock);
+        capture->quit = 1;
+        SDL_CondSignal(capture->changed);
+        SDL_UnlockMutex(capture->lock);
+        SDL_WaitThread(capture->thread, 0);
+    }
+
+    SDL_DestroyCond(capture->changed);
+    SDL_DestroyMutex(capture->lock);
+    for (int i = 0; i < CAPTURE_BUFFERS; i++)
+    {
+        SDL_free(capture->buffers[i]);
+    }
+
+    SDL_free(capture);
+}
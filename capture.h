@@ -0,0 +1,40 @@
+/**
+ * Saves rendered frames to image files. Frames are handed to a background
+ * thread for encoding so that saving them doesn't hold up the frame loop.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Struct to hold the frame capture state
+ */
+typedef struct capture capture;
+
+/**
+ * Starts the encoder thread.
+ *
+ * @param pattern printf style pattern for the file names, given the frame number,
+ *                e.g. "frames/%05d.png". Files ending .png are saved as PNG, anything
+ *                else as binary PPM.
+ * @param width   frame width in pixels
+ * @param height  frame height in pixels
+ * @returns       the capture, 0 if an error was encountered
+ */
+capture *open_capture(const char *pattern, int width, int height);
+
+/**
+ * Gets a buffer to copy the next frame into, as packed 24 bit RGB. Only waits
+ * if the encoder has fallen a number of frames behind.
+ */
+uint8_t *get_capture_buffer(capture *capture);
+
+/**
+ * Queues the frame in the buffer from get_capture_buffer to be saved.
+ */
+void submit_capture_buffer(capture *capture);
+
+/**
+ * Saves any frames still queued and stops the encoder thread.
+ */
+void close_capture(capture *capture);
@@ -0,0 +1,17 @@
+/**
+ * Colors shared by the game engine and the renderer
+ */
+#pragma once
+
+typedef enum color
+{
+    BLACK,
+    YELLOW,
+    GREEN,
+    PINK,
+    BLUE,
+    RED,
+    DARK
+} color;
+
+#define NUM_COLORS (DARK + 1)
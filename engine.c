@@ -0,0 +1,319 @@
+/**
+ * The rules of the game
+ */
+
+#include "engine.h"
+#include "zobrist.h"
+
+int get_level(const game_state *state)
+{
+    return ((INITIAL_SPEED - state->speed) / 10) + 1;
+}
+
+int get_gravity_per_tick(const game_state *state)
+{
+    return (GRAVITY_ONE + state->speed - 1) / state->speed;
+}
+
+int is_position_valid(const tetronimo *tetronimo, int new_x, int new_y, const board *board)
+{
+    return board_fits(board, tetronimo->rows, new_x, new_y);
+}
+
+/**
+ * Moves the shape by the given number of cells if it fits there.
+ *
+ * @returns 1 if the shape moved, 0 otherwise
+ */
+static int move_shape(shape *shape, int dx, int dy, const board *board)
+{
+    if (!is_position_valid(get_tetronimo(shape->piece, shape->direction), shape->x + dx, shape->y + dy, board))
+    {
+        return 0;
+    }
+
+    shape->key ^= zobrist_x(shape->x) ^ zobrist_x(shape->x + dx) ^ zobrist_y(shape->y) ^ zobrist_y(shape->y + dy);
+    shape->x += dx;
+    shape->y += dy;
+    return 1;
+}
+
+/**
+ * Rotates the shape if its new orientation fits in the play area.
+ *
+ * @returns 1 if the shape rotated, 0 otherwise
+ */
+static int rotate_shape(shape *shape, rotation rotation, const board *board)
+{
+    direction direction = rotate(shape->piece, shape->direction, rotation);
+    if (direction == shape->direction ||
+        !is_position_valid(get_tetronimo(shape->piece, direction), shape->x, shape->y, board))
+    {
+        return 0;
+    }
+
+    shape->key ^= zobrist_piece(shape->piece, shape->direction) ^ zobrist_piece(shape->piece, direction);
+    shape->direction = direction;
+    return 1;
+}
+
+/**
+ * Original Nintendo scoring system.
+ */
+static void update_score(game_state *state, int num_rows)
+{
+    static int SCORE_TABLE[5] = { 0, 40, 100, 300, 1200 };
+    state->score += SCORE_TABLE[num_rows] * get_level(state);
+    state->lines += num_rows;
+}
+
+/**
+ * Adds the tetronimo to the playing area. Removes full rows and updates the game score.
+ * The board's hash follows both.
+ */
+static void add_shape_to_grid(board *board, shape *shape, game_state *state)
+{
+    const tetronimo *tetronimo = get_tetronimo(shape->piece, shape->direction);
+    board_place(board, tetronimo->rows, shape->x, shape->y, shape->color);
+
+    // Only the rows the tetronimo covers can have been filled
+    int row_count = board_clear_full_rows(board, shape->y + tetronimo->top, tetronimo->bottom - tetronimo->top + 1);
+    update_score(state, row_count);
+}
+
+/**
+ * Tops up the queue of upcoming tetronimoes with another batch
+ */
+static void fill_queue(piece_queue *queue, rng *rng, randomizer randomizer)
+{
+    uint8_t batch[NUM_TETRONIMOES];
+    for (int i = 0; i < NUM_TETRONIMOES; i++)
+    {
+        batch[i] = i;
+    }
+
+    if (randomizer == RANDOMIZER_BAG)
+    {
+        // Fisher-Yates shuffle
+        for (int i = NUM_TETRONIMOES - 1; i > 0; i--)
+        {
+            int j = rng_range(rng, i + 1);
+            uint8_t tmp = batch[i];
+            batch[i] = batch[j];
+            batch[j] = tmp;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < NUM_TETRONIMOES; i++)
+        {
+            batch[i] = rng_range(rng, NUM_TETRONIMOES);
+        }
+    }
+
+    for (int i = 0; i < NUM_TETRONIMOES; i++)
+    {
+        queue->pieces[(queue->head + queue->count++) & (PIECE_QUEUE_SIZE - 1)] = batch[i];
+    }
+}
+
+/**
+ * Takes the next tetronimo from the queue, keeping at least a full batch queued
+ * so that there is always something to look ahead at.
+ */
+static int next_piece(engine *engine)
+{
+    piece_queue *queue = &engine->queue;
+    while (queue->count <= NUM_TETRONIMOES)
+    {
+        fill_queue(queue, &engine->rng, engine->randomizer);
+    }
+
+    int piece = queue->pieces[queue->head];
+    queue->head = (queue->head + 1) & (PIECE_QUEUE_SIZE - 1);
+    queue->count--;
+    return piece;
+}
+
+/**
+ * Sets up a new random shape at the top of the screen with a random color
+ */
+static void reset_shape(engine *engine)
+{
+    shape *shape = &engine->shape;
+    shape->piece = next_piece(engine);
+    shape->direction = UP;
+
+    shape->color = rng_range(&engine->rng, BLUE) + 1;
+    shape->x = SPAWN_X;
+    shape->y = SPAWN_Y;
+    shape->key = zobrist_shape(shape->piece, shape->direction, shape->x, shape->y);
+}
+
+static void init_game(game_state *state)
+{
+    state->gravity = 0;
+    state->num_pieces = 1;
+    state->action = RUNNING;
+    state->speed = INITIAL_SPEED;
+    state->lines = 0;
+    state->score = 0;
+}
+
+/**
+ * Prepare the state for the next tick. Gravity per tick is rounded up so that
+ * a shape falls one row every speed ticks.
+ */
+static void new_tick(game_state *state)
+{
+    state->gravity += state->action == RUNNING ? get_gravity_per_tick(state) : 0;
+}
+
+/**
+ * Checks if it is time to increase the level of difficulty, i.e. increase
+ * the speed that tetronimoes drop down.
+ */
+static void check_level(game_state *state)
+{
+    if (state->num_pieces % 10 == 0 && state->speed > 10)
+    {
+        state->speed -= 10;
+    }
+}
+
+/**
+ * Checks if it is time to force the tetronimo down a row.
+ */
+static int check_force_down(game_state *state)
+{
+    if (state->gravity >= GRAVITY_ONE)
+    {
+        state->gravity -= GRAVITY_ONE;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * End of life for a shape. Add it to the grid and select a new one.
+ * Check for end of game and the level of difficulty.
+ *
+ * @returns the engine_event flags describing the outcome
+ */
+static int end_shape(engine *engine)
+{
+    game_state *state = &engine->state;
+    board *board = &engine->board;
+    shape *shape = &engine->shape;
+    int events = EVENT_LOCKED;
+    add_shape_to_grid(board, shape, state);
+    reset_shape(engine);
+    state->num_pieces++;
+    if (!is_position_valid(get_tetronimo(shape->piece, shape->direction), shape->x, shape->y, board))
+    {
+        shape->color = RED;
+        state->action = STOPPED;
+        events |= EVENT_GAME_OVER;
+    }
+
+    check_level(state);
+    return events;
+}
+
+/**
+ * Starts a new game, carrying on with the random number sequence of any previous one
+ */
+static void new_game(engine *engine)
+{
+    init_game(&engine->state);
+    engine->queue.head = engine->queue.count = 0;
+    reset_shape(engine);
+    board_clear(&engine->board);
+}
+
+void engine_init(engine *engine, uint64_t seed, randomizer randomizer)
+{
+    rng_seed(&engine->rng, seed);
+    engine->randomizer = randomizer;
+    engine->ticks = 0;
+    new_game(engine);
+}
+
+int engine_peek(const engine *engine, int n)
+{
+    return engine->queue.pieces[(engine->queue.head + n) & (PIECE_QUEUE_SIZE - 1)];
+}
+
+uint64_t engine_hash(const engine *engine)
+{
+    return engine->board.hash ^ engine->shape.key;
+}
+
+int engine_step(engine *engine, engine_action action)
+{
+    game_state *state = &engine->state;
+    shape *shape = &engine->shape;
+    board *board = &engine->board;
+    int events = 0;
+
+    switch (action)
+    {
+    case ACTION_TICK:
+        engine->ticks++;
+        break;
+    case ACTION_PAUSE:
+        if (state->action != STOPPED)
+        {
+            state->action = state->action == RUNNING ? PAUSED : RUNNING;
+        }
+        return 0;
+    case ACTION_RESTART:
+        new_game(engine);
+        return EVENT_LOCKED;
+    default:
+        break;
+    }
+
+    if (state->action != RUNNING)
+    {
+        return 0;
+    }
+
+    switch (action)
+    {
+    case ACTION_TICK:
+        new_tick(state);
+        while (check_force_down(state))
+        {
+            if (!move_shape(shape, 0, 1, board))
+            {
+                // The next shape starts a fresh gravity count
+                state->gravity = 0;
+                return end_shape(engine);
+            }
+
+            events = EVENT_MOVED;
+        }
+        return events;
+    case ACTION_LEFT:
+        return move_shape(shape, -1, 0, board) ? EVENT_MOVED : 0;
+    case ACTION_RIGHT:
+        return move_shape(shape, 1, 0, board) ? EVENT_MOVED : 0;
+    case ACTION_DOWN:
+        return move_shape(shape, 0, 1, board) ? EVENT_MOVED : 0;
+    case ACTION_ROTATE_CW:
+        return rotate_shape(shape, NINETY_DEGREES, board) ? EVENT_MOVED : 0;
+    case ACTION_ROTATE_CCW:
+        return rotate_shape(shape, TWO_SEVENTY_DEGREES, board) ? EVENT_MOVED : 0;
+    case ACTION_DROP:
+        // Keep moving down until the shape lands, the next shape starts a fresh gravity count
+        while (move_shape(shape, 0, 1, board))
+        {
+        }
+        state->gravity = 0;
+        return end_shape(engine);
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,164 @@
+/**
+ * Headless game engine. Holds the rules of the game and has no SDL dependency
+ * so it can be driven by the interactive game, bots or test harnesses alike.
+ */
+#pragma once
+
+#include "board.h"
+#include "color.h"
+#include "rng.h"
+#include "tetronimoes.h"
+
+#define INITIAL_SPEED 90
+
+// Where new shapes appear, in grid cells
+#define SPAWN_X (GRID_CELL_WIDTH / 2)
+#define SPAWN_Y 0
+
+// The simulation advances in fixed ticks of 1 / ENGINE_TICK_RATE seconds
+#define ENGINE_TICK_RATE 60
+
+// Gravity is tracked in fixed point, GRAVITY_ONE is a whole row
+#define GRAVITY_ONE (1 << 16)
+
+// Size of the queue of upcoming tetronimoes, must be a power of two
+#define PIECE_QUEUE_SIZE 16
+
+/**
+ * An in-play tetronimo
+ */
+typedef struct shape
+{
+    int piece;            // id of the selected tetronimo
+    direction direction;  // the direction the tetronimo is facing
+    color color;          // index to the color array
+    int x;                // column of the tetronimo's matrix, may be off the board on the left
+    int y;                // row of the tetronimo's matrix, may be above the top of the board
+    uint64_t key;         // Zobrist key of the piece, direction and position
+} shape;
+
+typedef enum game_action { RUNNING, PAUSED, STOPPED } game_action;
+
+/**
+ * Variables to control the state of the game
+ */
+typedef struct game_state
+{
+    int speed;   // ticks taken to fall one row
+    int gravity; // fixed point progress of the shape towards the next row
+    game_action action;
+    int num_pieces;
+    int lines;   // rows cleared
+    int score;
+} game_state;
+
+/**
+ * How the sequence of tetronimoes is chosen
+ */
+typedef enum randomizer
+{
+    RANDOMIZER_UNIFORM, // every tetronimo is picked independently
+    RANDOMIZER_BAG      // each run of seven is a shuffled set of all the tetronimoes
+} randomizer;
+
+/**
+ * Upcoming tetronimoes, topped up a batch of NUM_TETRONIMOES at a time
+ */
+typedef struct piece_queue
+{
+    uint8_t pieces[PIECE_QUEUE_SIZE];
+    int head;
+    int count;
+} piece_queue;
+
+/**
+ * Everything needed to run a single game
+ */
+typedef struct engine
+{
+    board board;
+    shape shape;
+    game_state state;
+    rng rng;
+    randomizer randomizer;
+    piece_queue queue;
+    uint64_t ticks; // ticks since engine_init, including any while paused or stopped
+} engine;
+
+/**
+ * Inputs that advance the game
+ */
+typedef enum engine_action
+{
+    ACTION_NONE,
+    ACTION_TICK,       // one tick of time passing, applies gravity
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_DOWN,
+    ACTION_ROTATE_CW,
+    ACTION_ROTATE_CCW,
+    ACTION_DROP,       // drop the shape as far as it will go and lock it
+    ACTION_PAUSE,      // toggles between running and paused
+    ACTION_RESTART
+} engine_action;
+
+/**
+ * Flags returned by engine_step describing what happened
+ */
+typedef enum engine_event
+{
+    EVENT_MOVED = 1,    // the in-play shape moved or rotated
+    EVENT_LOCKED = 2,   // the shape was added to the board and a new one selected
+    EVENT_GAME_OVER = 4 // the new shape did not fit, the game has stopped
+} engine_event;
+
+/**
+ * Starts a new game. Games started with the same seed and randomizer and given
+ * the same actions always play out the same way.
+ *
+ * @param engine     the game to start
+ * @param seed       seed for the game's random number generator
+ * @param randomizer how the sequence of tetronimoes is chosen
+ */
+void engine_init(engine *engine, uint64_t seed, randomizer randomizer);
+
+/**
+ * Advances the game by applying a single action.
+ *
+ * @param engine the game to update
+ * @param action the action to apply
+ * @returns      a combination of engine_event flags
+ */
+int engine_step(engine *engine, engine_action action);
+
+/**
+ * Checks to see if the tetronimo at the given grid position fits in the
+ * play area and does not overlap any cells in the board.
+ */
+int is_position_valid(const tetronimo *tetronimo, int new_x, int new_y, const board *board);
+
+/**
+ * Looks ahead at the upcoming tetronimoes.
+ *
+ * @param engine the game
+ * @param n      how far ahead to look, 0 is the next tetronimo. Must be less
+ *               than NUM_TETRONIMOES.
+ * @returns      the id of the tetronimo
+ */
+int engine_peek(const engine *engine, int n);
+
+/**
+ * Gets the Zobrist hash of the board and the in-play shape. Both parts are
+ * kept up to date as the game is played, so this is a single XOR.
+ */
+uint64_t engine_hash(const engine *engine);
+
+/**
+ * Gets the current level from the game state
+ */
+int get_level(const game_state *state);
+
+/**
+ * Gets how far the shape falls each tick, in fixed point where GRAVITY_ONE is a whole row
+ */
+int get_gravity_per_tick(const game_state *state);
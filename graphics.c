@@ -1,36 +1,73 @@
-#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 
+#include "arena.h"
+#include "assets.h"
+#include "atlas.h"
+#include "capture.h"
 #include "graphics.h"
 
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
 #define IMAGE_COUNT 5
+#define LAYER_COUNT 2
+#define FIRST_GLYPH ' '
+#define LAST_GLYPH '~'
+#define GLYPH_COUNT (LAST_GLYPH - FIRST_GLYPH + 1)
+#define TILE_SIZE 4
+#define ATLAS_WIDTH 512
+#define BATCH_SIZE 1024
 
+/**
+ * A loaded image, kept as a surface until it is packed into the atlas
+ */
 struct image
 {
-    SDL_Texture *texture;
-    int width;
-    int height;
+    SDL_Surface *surface;
+    SDL_Rect region;
 };
 
 struct graphics
 {
-    SDL_Window *window;     // The window we'll be rendering to
-    SDL_Renderer *renderer; // The renderer to draw the texture on the window
-    TTF_Font *font;         // Font for displaying text
-    struct image **images;   // Loaded images
+    SDL_Window *window;                       // The window we'll be rendering to, 0 when headless
+    SDL_Surface *surface;                     // Offscreen surface rendered to when headless
+    SDL_Renderer *renderer;                   // The renderer to draw the texture on the window
+    TTF_Font *font;                           // Font for displaying text
+    struct image images[IMAGE_COUNT];         // Loaded images
+    int image_count;
+    SDL_Texture *atlas;                       // Images, glyphs and color tiles, everything is drawn from here
+    SDL_Surface *atlas_surface;               // Kept to recreate the atlas texture if the render device is reset
+    float atlas_width;
+    float atlas_height;
+    SDL_Rect glyphs[GLYPH_COUNT];             // Printable ASCII characters in the atlas
+    SDL_Rect tiles[NUM_COLORS];               // Solid color squares in the atlas, for filled rectangles
+    SDL_Vertex vertices[BATCH_SIZE * 4];      // Sprites waiting to be drawn, four corners each
+    int indices[BATCH_SIZE * 6];              // Two triangles per sprite, the same every frame
+    int sprite_count;                         // Number of queued sprites
+    SDL_Texture *layers[LAYER_COUNT];         // Retained screen layers, redrawn only on request
+    capture *capture;                         // Saves frames to files when set
+    int frame_interval;                       // ms between frames if presenting doesn't wait for vsync, 0 if it does
+};
+
+static const SDL_Color palette[NUM_COLORS] = {
+    [BLACK] = { 0x00, 0x00, 0x00, 0xFF },
+    [YELLOW] = { 0xEB, 0xCB, 0x8B, 0xFF },
+    [GREEN] = { 0xA3, 0xBE, 0x8C, 0xFF },
+    [PINK] = { 0xB4, 0x8E, 0xAD, 0xFF },
+    [BLUE] = { 0x5E, 0x81, 0xAC, 0xFF },
+    [RED] = { 0xBF, 0x61, 0x6A, 0xFF },
+    [DARK] = { 0x4C, 0x56, 0x6A, 0xFF }
 };
 
 /**
- * Loads the TTF font at the specified path
+ * Loads a TTF font from memory. The data must outlive the font.
  */
-static TTF_Font *load_font(const char *path)
+static TTF_Font *load_font(const void *data, size_t size)
 {
-    TTF_Font *ttf_font = TTF_OpenFont(path, 30);
+    TTF_Font *ttf_font = TTF_OpenFontRW(SDL_RWFromConstMem(data, (int)size), 1, 30);
     if (!ttf_font)
     {
         fprintf(stderr, "Failed to load font. SDL_ttf Error: %s\n", TTF_GetError());
@@ -41,99 +78,172 @@ static TTF_Font *load_font(const char *path)
 }
 
 /**
- * Set the renderer up to draw using one of the pre-defined colors
+ * Renders each printable character to its own surface. Each surface is as wide
+ * as the character's advance so characters can be drawn side by side.
+ *
+ * @returns 0 on success, 1 if an error was encountered
  */
-static void set_render_color(graphics *graphics, color color)
+static int render_glyphs(graphics *graphics, SDL_Surface **surfaces)
 {
-    switch (color)
-    {
-    case BLACK:
-        SDL_SetRenderDrawColor(graphics->renderer, 0x00, 0x00, 0x00, 0xFF);
-        break;
-    case YELLOW:
-        SDL_SetRenderDrawColor(graphics->renderer, 0xEB, 0xCB, 0x8B, 0xFF);
-        break;
-    case GREEN:
-        SDL_SetRenderDrawColor(graphics->renderer, 0xA3, 0xBE, 0x8C, 0xFF);
-        break;
-    case PINK:
-        SDL_SetRenderDrawColor(graphics->renderer, 0xB4, 0x8E, 0xAD, 0xFF);
-        break;
-    case BLUE:
-        SDL_SetRenderDrawColor(graphics->renderer, 0x5E, 0x81, 0xAC, 0xFF);
-        break;
-    case RED:
-        SDL_SetRenderDrawColor(graphics->renderer, 0xBF, 0x61, 0x6A, 0xFF);
-        break;
-    case DARK:
-        SDL_SetRenderDrawColor(graphics->renderer, 0x4C, 0x56, 0x6A, 0xFF);
-        break;
+    SDL_Color text_color = { 0xEC, 0xEF, 0xF4, 0xFF };
+    char text[2] = { 0 };
+    for (int i = 0; i < GLYPH_COUNT; i++)
+    {
+        text[0] = FIRST_GLYPH + i;
+        surfaces[i] = TTF_RenderText_Blended(graphics->font, text, text_color);
+        if (!surfaces[i])
+        {
+            fprintf(stderr, "Unable to render glyph. SDL_ttf Error: %s\n", TTF_GetError());
+            return 1;
+        }
     }
+
+    return 0;
 }
 
 /**
- * Render some text to the screen
+ * Creates a small square of each color
+ *
+ * @returns 0 on success, 1 if an error was encountered
  */
-static int render_text_texture(graphics *graphics, const char *message, int x, int y)
+static int create_tiles(SDL_Surface **surfaces)
 {
-    // Render text
-    SDL_Color text_color = { 0xEC, 0xEF, 0xF4, 0xFF };
-    SDL_Color back_color = { 0x2E, 0x34, 0x40, 0xFF };
-    SDL_Surface *text_surface = TTF_RenderText_Shaded(graphics->font, message, text_color, back_color);
-    if (!text_surface)
+    for (int i = 0; i < NUM_COLORS; i++)
     {
-        fprintf(stderr, "Unable to render text surface. SDL_ttf Error: %s\n", TTF_GetError());
-        return 1;
+        surfaces[i] = SDL_CreateRGBSurfaceWithFormat(0, TILE_SIZE, TILE_SIZE, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (!surfaces[i])
+        {
+            fprintf(stderr, "Unable to create tile. SDL Error: %s\n", SDL_GetError());
+            return 1;
+        }
+
+        SDL_FillRect(surfaces[i], 0, SDL_MapRGBA(surfaces[i]->format, palette[i].r, palette[i].g, palette[i].b,
+                                                palette[i].a));
     }
 
-    // Create texture from surface pixels
-    SDL_Texture *text_text = SDL_CreateTextureFromSurface(graphics->renderer, text_surface);
-    if (!text_text)
+    return 0;
+}
+
+/**
+ * Draws the queued sprites in a single geometry call
+ */
+static void flush_sprites(graphics *graphics)
+{
+    if (graphics->sprite_count)
     {
-        fprintf(stderr, "Unable to create texture from rendered text. SDL Error: %s\n", SDL_GetError());
-        return 1;
+        if (SDL_RenderGeometry(graphics->renderer, graphics->atlas, graphics->vertices, graphics->sprite_count * 4,
+                               graphics->indices, graphics->sprite_count * 6))
+        {
+            fprintf(stderr, "Unable to render geometry. SDL Error: %s\n", SDL_GetError());
+        }
+
+        graphics->sprite_count = 0;
     }
+}
 
-    // Render the texture
-    SDL_Rect render_quad = { x, y, text_surface->w, text_surface->h };
-    if (SDL_RenderCopy(graphics->renderer, text_text, 0, &render_quad))
+/**
+ * Queues part of the atlas to be drawn to a rectangle on the screen
+ */
+static void queue_sprite(graphics *graphics, const SDL_Rect *region, int x, int y, int width, int height)
+{
+    if (graphics->sprite_count == BATCH_SIZE)
     {
-        fprintf(stderr, "Unable to render text. SDL Error: %s\n", SDL_GetError());
-        return 1;
+        flush_sprites(graphics);
     }
 
-    SDL_FreeSurface(text_surface);
-    SDL_DestroyTexture(text_text);
-
-    return 0;
+    float left = region->x / graphics->atlas_width;
+    float top = region->y / graphics->atlas_height;
+    float right = (region->x + region->w) / graphics->atlas_width;
+    float bottom = (region->y + region->h) / graphics->atlas_height;
+    SDL_Color white = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+    SDL_Vertex *vertex = &graphics->vertices[graphics->sprite_count++ * 4];
+    vertex[0] = (SDL_Vertex){ { x, y }, white, { left, top } };
+    vertex[1] = (SDL_Vertex){ { x + width, y }, white, { right, top } };
+    vertex[2] = (SDL_Vertex){ { x, y + height }, white, { left, bottom } };
+    vertex[3] = (SDL_Vertex){ { x + width, y + height }, white, { right, bottom } };
 }
 
-graphics *init_graphics()
+/**
+ * Creates a software renderer drawing to an offscreen surface
+ */
+static SDL_Renderer *create_headless_renderer(SDL_Surface **surface)
 {
-    // Initialise SDL and the SDL video subsystem
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    *surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!*surface)
     {
-        fprintf(stderr, "SDL init failed. SDL_Error:%s\n", SDL_GetError());
+        fprintf(stderr, "Surface could not be created. SDL_Error: %s\n", SDL_GetError());
         return 0;
     }
 
-    // Create window
-    SDL_Window *window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                                        SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    if (!window)
+    SDL_Renderer *renderer = SDL_CreateSoftwareRenderer(*surface);
+    if (!renderer)
+    {
+        fprintf(stderr, "Renderer could not be created. SDL Error: %s\n", SDL_GetError());
+    }
+
+    return renderer;
+}
+
+/**
+ * Works out how long to wait between frames if the renderer can't wait for vsync
+ *
+ * @returns the display's refresh interval in ms, 0 if presenting waits for vsync
+ */
+static int get_refresh_interval(SDL_Window *window, SDL_Renderer *renderer)
+{
+    SDL_RendererInfo info;
+    if (!SDL_GetRendererInfo(renderer, &info) && info.flags & SDL_RENDERER_PRESENTVSYNC)
     {
-        fprintf(stderr, "Window could not be created. SDL_Error: %s\n", SDL_GetError());
         return 0;
     }
 
-    // Create renderer for window
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (!renderer)
+    SDL_DisplayMode mode;
+    int refresh_rate = SDL_GetWindowDisplayMode(window, &mode) || !mode.refresh_rate ? 60 : mode.refresh_rate;
+    return 1000 / refresh_rate;
+}
+
+graphics *init_graphics(int flags)
+{
+    // Initialise SDL, the video subsystem is only needed for a window
+    if (SDL_Init(flags & GRAPHICS_HEADLESS ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) < 0)
     {
-        fprintf(stderr, "Renderer could not be created. SDL Error: %s\n", SDL_GetError());
+        fprintf(stderr, "SDL init failed. SDL_Error:%s\n", SDL_GetError());
         return 0;
     }
 
+    SDL_Window *window = 0;
+    SDL_Surface *surface = 0;
+    SDL_Renderer *renderer;
+    if (flags & GRAPHICS_HEADLESS)
+    {
+        renderer = create_headless_renderer(&surface);
+        if (!renderer)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        // Create window
+        window = SDL_CreateWindow("Tetris", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                  SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+        if (!window)
+        {
+            fprintf(stderr, "Window could not be created. SDL_Error: %s\n", SDL_GetError());
+            return 0;
+        }
+
+        // Create renderer for window, presenting in step with the display whatever its refresh rate
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE |
+                                                      SDL_RENDERER_PRESENTVSYNC);
+        if (!renderer)
+        {
+            fprintf(stderr, "Renderer could not be created. SDL Error: %s\n", SDL_GetError());
+            return 0;
+        }
+    }
+
     // Initialize PNG loading
     int imgFlags = IMG_INIT_PNG;
     if (!(IMG_Init(imgFlags) & imgFlags))
@@ -149,138 +259,336 @@ graphics *init_graphics()
         return 0;
     }
 
-    graphics *graphics = calloc(1, sizeof(struct graphics));
+    graphics *graphics = arena_alloc(sizeof(struct graphics));
+    if (!graphics)
+    {
+        return 0;
+    }
+
     graphics->window = window;
+    graphics->surface = surface;
     graphics->renderer = renderer;
-    graphics->images = calloc(IMAGE_COUNT, sizeof(struct image*));
+    graphics->frame_interval = window ? get_refresh_interval(window, renderer) : 0;
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        int *indices = &graphics->indices[i * 6];
+        indices[0] = i * 4;
+        indices[1] = indices[4] = i * 4 + 1;
+        indices[2] = indices[3] = i * 4 + 2;
+        indices[5] = i * 4 + 3;
+    }
+
+    graphics->font = load_font(assets_Arial_ttf, assets_Arial_ttf_len);
+    if (!graphics->font)
+    {
+        close_graphics(graphics);
+        return 0;
+    }
 
     return graphics;
 }
 
+static int create_atlas_texture(graphics *graphics)
+{
+    graphics->atlas = SDL_CreateTextureFromSurface(graphics->renderer, graphics->atlas_surface);
+    if (!graphics->atlas)
+    {
+        fprintf(stderr, "Unable to create atlas texture. SDL Error: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    SDL_SetTextureBlendMode(graphics->atlas, SDL_BLENDMODE_BLEND);
+    return 0;
+}
+
+int build_atlas(graphics *graphics)
+{
+    SDL_Surface *surfaces[IMAGE_COUNT + GLYPH_COUNT + NUM_COLORS] = { 0 };
+    SDL_Rect regions[IMAGE_COUNT + GLYPH_COUNT + NUM_COLORS];
+    SDL_Surface **glyphs = surfaces + graphics->image_count;
+    SDL_Surface **tiles = glyphs + GLYPH_COUNT;
+    int count = graphics->image_count + GLYPH_COUNT + NUM_COLORS;
+    for (int i = 0; i < graphics->image_count; i++)
+    {
+        surfaces[i] = graphics->images[i].surface;
+        graphics->images[i].surface = 0;
+    }
+
+    int result = 1;
+    SDL_Surface *atlas = 0;
+    if (render_glyphs(graphics, glyphs) || create_tiles(tiles))
+    {
+        goto done;
+    }
+
+    atlas = pack_atlas(surfaces, count, ATLAS_WIDTH, regions);
+    if (!atlas)
+    {
+        goto done;
+    }
+
+    graphics->atlas_surface = atlas;
+    atlas = 0;
+    if (create_atlas_texture(graphics))
+    {
+        goto done;
+    }
+
+    graphics->atlas_width = graphics->atlas_surface->w;
+    graphics->atlas_height = graphics->atlas_surface->h;
+    for (int i = 0; i < graphics->image_count; i++)
+    {
+        graphics->images[i].region = regions[i];
+    }
+
+    memcpy(graphics->glyphs, regions + graphics->image_count, sizeof(graphics->glyphs));
+    for (int i = 0; i < NUM_COLORS; i++)
+    {
+        // Sample only the middle of the tile so filtering never reaches the transparent border
+        SDL_Rect *tile = &regions[graphics->image_count + GLYPH_COUNT + i];
+        graphics->tiles[i] = (SDL_Rect){ tile->x + 1, tile->y + 1, tile->w - 2, tile->h - 2 };
+    }
+
+    result = 0;
+
+done:
+    SDL_FreeSurface(atlas);
+    for (int i = 0; i < count; i++)
+    {
+        SDL_FreeSurface(surfaces[i]);
+    }
+
+    return result;
+}
+
 void clear_frame(graphics *graphics)
 {
+    flush_sprites(graphics);
     SDL_SetRenderDrawColor(graphics->renderer, 0x2E, 0x34, 0x40, 0xFF);
     SDL_RenderClear(graphics->renderer);
 }
 
 void render_quad(graphics *graphics, int x, int y, int width, int height, int filled, color color)
 {
-    SDL_Rect outline = { x, y, width, height };
-    set_render_color(graphics, color);
+    SDL_Rect *tile = &graphics->tiles[color];
     if (filled)
     {
-        SDL_RenderFillRect(graphics->renderer, &outline);
+        queue_sprite(graphics, tile, x, y, width, height);
     }
     else
     {
-        SDL_RenderDrawRect(graphics->renderer, &outline);
+        // Same pixels as SDL_RenderDrawRect
+        queue_sprite(graphics, tile, x, y, width, 1);
+        queue_sprite(graphics, tile, x, y + height - 1, width, 1);
+        queue_sprite(graphics, tile, x, y + 1, 1, height - 2);
+        queue_sprite(graphics, tile, x + width - 1, y + 1, 1, height - 2);
     }
 }
 
 void render_line(graphics *graphics, int x, int y, int l)
 {
-    set_render_color(graphics, DARK);
-    SDL_RenderDrawLine(graphics->renderer, x, y, x + l, y);
+    // Inclusive of both ends, as SDL_RenderDrawLine is
+    queue_sprite(graphics, &graphics->tiles[DARK], x, y, l + 1, 1);
 }
 
 void render_message(graphics *graphics, char* message, int x, int y)
 {
-    if (!graphics->font)
+    for (; *message; message++)
     {
-        graphics->font = load_font("assets/Arial.ttf");
+        if (*message < FIRST_GLYPH || *message > LAST_GLYPH)
+        {
+            continue;
+        }
+
+        SDL_Rect *glyph = &graphics->glyphs[*message - FIRST_GLYPH];
+        queue_sprite(graphics, glyph, x, y, glyph->w, glyph->h);
+        x += glyph->w;
     }
+}
 
-    render_text_texture(graphics, message, x, y);
+int start_capture(graphics *graphics, const char *pattern)
+{
+    graphics->capture = open_capture(pattern, SCREEN_WIDTH, SCREEN_HEIGHT);
+    return graphics->capture ? 0 : 1;
 }
 
 void commit_to_screen(graphics *graphics)
 {
+    flush_sprites(graphics);
+
+    // Read back before presenting, the back buffer is undefined afterwards
+    if (graphics->capture)
+    {
+        uint8_t *pixels = get_capture_buffer(graphics->capture);
+        if (SDL_RenderReadPixels(graphics->renderer, 0, SDL_PIXELFORMAT_RGB24, pixels, SCREEN_WIDTH * 3))
+        {
+            fprintf(stderr, "Unable to read frame. SDL Error: %s\n", SDL_GetError());
+        }
+        else
+        {
+            submit_capture_buffer(graphics->capture);
+        }
+    }
+
     SDL_RenderPresent(graphics->renderer);
 }
 
-int load_image(graphics *graphics, const char *path)
+int get_frame_interval(graphics *graphics)
+{
+    return graphics->frame_interval;
+}
+
+int load_image(graphics *graphics, const void *data, size_t size)
 {
-    SDL_Surface *loaded_surface = IMG_Load(path);
+    if (graphics->image_count == IMAGE_COUNT)
+    {
+        fprintf(stderr, "Unable to load image. No more than %d images allowed\n", IMAGE_COUNT);
+        return -1;
+    }
+
+    SDL_Surface *loaded_surface = IMG_Load_RW(SDL_RWFromConstMem(data, (int)size), 1);
     if (!loaded_surface)
     {
         fprintf(stderr, "Unable to load image. SDL_image Error: %s\n", IMG_GetError());
         return -1;
     }
 
-    // Color key image. Specify a pixel that will be treated as transparent, in this case cyan.
-    //SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
+    graphics->images[graphics->image_count].surface = loaded_surface;
+    return graphics->image_count++;
+}
 
-    // Create texture from surface pixels
-    SDL_Texture *image_texture = SDL_CreateTextureFromSurface(graphics->renderer, loaded_surface);
-    if (!image_texture)
+void render_image(graphics *graphics, int handle, int x, int y, SDL_Rect *sprite)
+{
+    SDL_Rect region = graphics->images[handle].region;
+    if (sprite)
     {
-        fprintf(stderr, "Unable to create texture from %s. SDL Error: %s\n", path, SDL_GetError());
-        return -1;
+        region = (SDL_Rect){ region.x + sprite->x, region.y + sprite->y, sprite->w, sprite->h };
     }
 
-    struct image *img = malloc(sizeof(struct image));
-    img->texture = image_texture;
-    img->width = loaded_surface->w;
-    img->height = loaded_surface->h;
+    queue_sprite(graphics, &region, x, y, region.w, region.h);
+}
 
-    SDL_FreeSurface(loaded_surface);
+static SDL_Texture *create_layer_texture(graphics *graphics)
+{
+    SDL_Texture *texture = SDL_CreateTexture(graphics->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                             SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (!texture)
+    {
+        fprintf(stderr, "Unable to create layer texture. SDL Error: %s\n", SDL_GetError());
+    }
 
-    // Find unused handle
-    for (int i = 0; i < IMAGE_COUNT; i++)
+    return texture;
+}
+
+int create_layer(graphics *graphics)
+{
+    for (int i = 0; i < LAYER_COUNT; i++)
     {
-        if (graphics->images[i] == 0)
+        if (graphics->layers[i] == 0)
         {
-            graphics->images[i] = img;
-            return i;
+            graphics->layers[i] = create_layer_texture(graphics);
+            return graphics->layers[i] ? i : -1;
         }
     }
 
     return -1;
 }
 
-void render_image(graphics *graphics, int handle, int x, int y, SDL_Rect *sprite)
+void begin_layer(graphics *graphics, int handle)
 {
-    // TODO: some error handling needed here
-    struct image *img = graphics->images[handle];
+    if (handle >= 0)
+    {
+        flush_sprites(graphics);
+        SDL_SetRenderTarget(graphics->renderer, graphics->layers[handle]);
+    }
+}
 
-    // Set rendering space and render to screen
-    SDL_Rect renderQuad = { x, y, img->width, img->height };
-    if (sprite)
+void end_layer(graphics *graphics, int handle)
+{
+    if (handle >= 0)
     {
-        img->width = sprite->w;
-        img->height = sprite->h;
+        flush_sprites(graphics);
+        SDL_SetRenderTarget(graphics->renderer, 0);
     }
-    
-    SDL_RenderCopy(graphics->renderer, img->texture, sprite, &renderQuad);
+}
+
+void render_layer(graphics *graphics, int handle)
+{
+    if (handle >= 0)
+    {
+        flush_sprites(graphics);
+        SDL_RenderCopy(graphics->renderer, graphics->layers[handle], 0, 0);
+    }
+}
+
+int reset_textures(graphics *graphics)
+{
+    int result = 0;
+    if (graphics->atlas)
+    {
+        SDL_DestroyTexture(graphics->atlas);
+        graphics->atlas = 0;
+        result |= create_atlas_texture(graphics);
+    }
+
+    for (int i = 0; i < LAYER_COUNT; i++)
+    {
+        if (graphics->layers[i])
+        {
+            SDL_DestroyTexture(graphics->layers[i]);
+            graphics->layers[i] = create_layer_texture(graphics);
+            result |= !graphics->layers[i];
+        }
+    }
+
+    return result;
 }
 
 void close_graphics(graphics *graphics)
 {
-    // Destroy window and renderer
-    SDL_DestroyRenderer(graphics->renderer);
-    SDL_DestroyWindow(graphics->window);
-    if (graphics->font)
+    if (graphics->capture)
     {
-        TTF_CloseFont(graphics->font);
-        TTF_Quit();
+        close_capture(graphics->capture);
     }
 
-    if (graphics->images)
+    // Textures belong to the renderer so must go first
+    for (int i = 0; i < LAYER_COUNT; i++)
     {
-        for (int i = 0; i < IMAGE_COUNT; i++)
+        if (graphics->layers[i])
         {
-            if (graphics->images[i])
-            {
-                SDL_DestroyTexture(graphics->images[i]->texture);
-                free(graphics->images[i]);
-                graphics->images[i] = 0;
-            }
+            SDL_DestroyTexture(graphics->layers[i]);
         }
+    }
+
+    if (graphics->atlas)
+    {
+        SDL_DestroyTexture(graphics->atlas);
+    }
+
+    SDL_FreeSurface(graphics->atlas_surface);
 
-        free(graphics->images);
+    // Images not yet packed into the atlas
+    for (int i = 0; i < graphics->image_count; i++)
+    {
+        SDL_FreeSurface(graphics->images[i].surface);
     }
 
-    free(graphics);
+    // Destroy window and renderer
+    SDL_DestroyRenderer(graphics->renderer);
+    if (graphics->window)
+    {
+        SDL_DestroyWindow(graphics->window);
+    }
+    else
+    {
+        SDL_FreeSurface(graphics->surface);
+    }
+
+    if (graphics->font)
+    {
+        TTF_CloseFont(graphics->font);
+        TTF_Quit();
+    }
 
     // Quit SDL subsys
     SDL_Quit();
@@ -3,26 +3,30 @@
  */
 #pragma once
 
-typedef enum color
-{
-    BLACK,
-    YELLOW,
-    GREEN,
-    PINK,
-    BLUE,
-    RED,
-    DARK
-} color;
+#include <stddef.h>
+
+#include "color.h"
 
 /**
  * Struct to hold graphics data
  */
 typedef struct graphics graphics;
 
+/**
+ * Options for init_graphics
+ */
+typedef enum graphics_flags
+{
+    GRAPHICS_HEADLESS = 1 // Draw to an offscreen software surface, no window or display needed
+} graphics_flags;
+
 /*
- * Starts up SDL and creates window
+ * Starts up SDL and creates window, or an offscreen surface when headless.
+ * Allocated from the arena, so call init_arena first.
+ *
+ * @param flags combination of graphics_flags
  */
-graphics *init_graphics(void);
+graphics *init_graphics(int flags);
 
 /**
  * Clears the screen ready for the next round of updates
@@ -30,7 +34,7 @@ graphics *init_graphics(void);
 void clear_frame(graphics *graphics);
 
 /*
- * Render a text message
+ * Render a text message from the glyphs in the atlas
  */
 void render_message(graphics *graphics, char* message, int x, int y);
 
@@ -45,14 +49,31 @@ void render_quad(graphics *graphics, int x, int y, int width, int height, int fi
 void render_line(graphics *graphics, int x, int y, int l);
 
 /**
- * Loads an image texture from a file. The returned handle can
- * be used to reference the image in later API calls.
+ * Gets how long to leave between frames. Windows present in step with the
+ * display so frames need no pacing, unless the driver can't wait for vsync.
+ *
+ * @returns the interval in ms, 0 if commit_to_screen already waits
+ */
+int get_frame_interval(graphics *graphics);
+
+/**
+ * Loads an image from PNG data in memory. The returned handle can be used
+ * to reference the image in later API calls, once build_atlas has been called.
  * 
  * @param graphics the graphics struct
- * @param path     path to the image .png file
+ * @param data     contents of a .png file
+ * @param size     size of the data in bytes
  * @returns        an image handle, -1 if an error was encountered
  */
-int load_image(graphics *graphics, const char *path);
+int load_image(graphics *graphics, const void *data, size_t size);
+
+/**
+ * Packs the loaded images, the font's characters and a tile of each color into
+ * the one texture that everything is drawn from. Call once after loading images.
+ *
+ * @returns 0 on success, 1 if an error was encountered
+ */
+int build_atlas(graphics *graphics);
 
 /**
  * Renders the specified image at the given location
@@ -60,11 +81,53 @@ int load_image(graphics *graphics, const char *path);
 void render_image(graphics *graphics, int handle, int x, int y, SDL_Rect *sprite);
 
 /**
- * Update the screen
+ * Creates a screen sized layer that keeps its contents between frames, so
+ * parts of the scene that rarely change can be drawn once and reused.
+ *
+ * @returns a layer handle, -1 if an error was encountered
+ */
+int create_layer(graphics *graphics);
+
+/**
+ * Directs all drawing into a layer until end_layer is called. A handle of -1
+ * leaves drawing going straight to the screen.
+ */
+void begin_layer(graphics *graphics, int handle);
+
+/**
+ * Finishes drawing into a layer and goes back to drawing on the screen.
+ */
+void end_layer(graphics *graphics, int handle);
+
+/**
+ * Copies a layer over the whole screen.
+ */
+void render_layer(graphics *graphics, int handle);
+
+/**
+ * Recreates the atlas and layer textures after the render device has been
+ * reset and they have been lost. Layer handles stay the same but their
+ * contents must be redrawn.
+ *
+ * @returns 0 on success, 1 if any texture couldn't be recreated, any layer
+ *          that couldn't be is no longer usable
+ */
+int reset_textures(graphics *graphics);
+
+/**
+ * Saves every frame from now on to an image file, see open_capture.
+ *
+ * @returns 0 on success, 1 if the capture could not be started
+ */
+int start_capture(graphics *graphics, const char *pattern);
+
+/**
+ * Update the screen. Drawing from the atlas is batched, so anything queued is
+ * drawn first, then the frame is captured if required.
  */
 void commit_to_screen(graphics *graphics);
 
 /*
- * Frees media and shuts down SDL
+ * Frees media and shuts down SDL. The graphics themselves go with the arena.
  */
 void close_graphics(graphics *graphics);
@@ -0,0 +1,143 @@
+/**
+ * Frame profiling using the high resolution clock
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+#include "profile.h"
+
+#define SAMPLE_COUNT 65536 // timed zones kept for the trace, must be a power of two
+#define FRAME_COUNT 256    // frame times and latencies kept for the percentiles, must be a power of two
+
+struct sample
+{
+    uint64_t start;
+    uint64_t end;
+    profile_zone zone;
+};
+
+static const char *zone_names[NUM_ZONES] = {
+    "frame",
+    "input",
+    "simulation",
+    "render_grid",
+    "render_ui",
+    "commit_to_screen",
+    "input_to_present"
+};
+
+// Zones may be timed on the game's thread as well as the main one
+static struct sample samples[SAMPLE_COUNT];
+static _Atomic uint64_t sample_total;
+static uint64_t frame_times[FRAME_COUNT];
+static uint64_t frame_total;
+static uint64_t latencies[FRAME_COUNT];
+static uint64_t latency_total;
+
+uint64_t start_timer(void)
+{
+    return SDL_GetPerformanceCounter();
+}
+
+void stop_timer(profile_zone zone, uint64_t start)
+{
+    uint64_t end = SDL_GetPerformanceCounter();
+    samples[atomic_fetch_add(&sample_total, 1) & (SAMPLE_COUNT - 1)] = (struct sample){ start, end, zone };
+    if (zone == ZONE_FRAME)
+    {
+        frame_times[frame_total++ & (FRAME_COUNT - 1)] = end - start;
+    }
+    else if (zone == ZONE_INPUT_LATENCY)
+    {
+        latencies[latency_total++ & (FRAME_COUNT - 1)] = end - start;
+    }
+}
+
+void stop_timer_from_ticks(profile_zone zone, uint32_t start_ms)
+{
+    uint64_t elapsed = (uint64_t)(SDL_GetTicks() - start_ms) * SDL_GetPerformanceFrequency() / 1000;
+    stop_timer(zone, SDL_GetPerformanceCounter() - elapsed);
+}
+
+/**
+ * Gets the median and 99th percentile of the times in a ring
+ *
+ * @param total the number of times ever added to the ring
+ */
+static void get_percentiles(const uint64_t *times, uint64_t total, int *p50_us, int *p99_us)
+{
+    uint64_t sorted[FRAME_COUNT];
+    int count = total < FRAME_COUNT ? (int)total : FRAME_COUNT;
+    if (!count)
+    {
+        *p50_us = *p99_us = 0;
+        return;
+    }
+
+    // Insertion sort, in place on the copy, as qsort may allocate
+    for (int i = 0; i < count; i++)
+    {
+        int j = i;
+        for (; j > 0 && sorted[j - 1] > times[i]; j--)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+
+        sorted[j] = times[i];
+    }
+
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    *p50_us = (int)(sorted[count / 2] * 1000000 / frequency);
+    *p99_us = (int)(sorted[(count * 99) / 100] * 1000000 / frequency);
+}
+
+void get_frame_percentiles(int *p50_us, int *p99_us)
+{
+    get_percentiles(frame_times, frame_total, p50_us, p99_us);
+}
+
+void get_latency_percentiles(int *p50_us, int *p99_us)
+{
+    get_percentiles(latencies, latency_total, p50_us, p99_us);
+}
+
+int write_trace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "Unable to open trace file %s\n", path);
+        return 1;
+    }
+
+    // Only the most recent samples are still in the ring
+    uint64_t first = sample_total > SAMPLE_COUNT ? sample_total - SAMPLE_COUNT : 0;
+    double us_per_count = 1000000.0 / SDL_GetPerformanceFrequency();
+
+    // Zones are recorded when they finish so the earliest start is not necessarily the first sample
+    uint64_t origin = UINT64_MAX;
+    for (uint64_t i = first; i < sample_total; i++)
+    {
+        uint64_t start = samples[i & (SAMPLE_COUNT - 1)].start;
+        origin = start < origin ? start : origin;
+    }
+
+    // The simulation gets a track of its own as it may run on its own thread, and latencies
+    // overlap frames so they get one too
+    fprintf(file, "{\"traceEvents\":[");
+    for (uint64_t i = first; i < sample_total; i++)
+    {
+        struct sample *sample = &samples[i & (SAMPLE_COUNT - 1)];
+        int tid = sample->zone == ZONE_SIMULATION ? 2 : sample->zone == ZONE_INPUT_LATENCY ? 3 : 1;
+        fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                i == first ? "" : ",", zone_names[sample->zone], tid,
+                (sample->start - origin) * us_per_count, (sample->end - sample->start) * us_per_count);
+    }
+
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+
+    return 0;
+}
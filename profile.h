@@ -0,0 +1,68 @@
+/**
+ * Lightweight frame profiling. Timed zones are kept in a fixed size ring buffer,
+ * so recording never allocates, and can be exported in the Chrome trace format
+ * for viewing in chrome://tracing or Perfetto.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * The parts of a frame that are timed
+ */
+typedef enum profile_zone
+{
+    ZONE_FRAME,       // the whole frame, not counting time spent waiting for the next one
+    ZONE_INPUT,
+    ZONE_SIMULATION,
+    ZONE_RENDER_GRID,
+    ZONE_RENDER_UI,
+    ZONE_COMMIT,
+    ZONE_INPUT_LATENCY, // from an input event to the first frame presented after the game has applied it
+    NUM_ZONES
+} profile_zone;
+
+/**
+ * Starts timing a zone.
+ *
+ * @returns the start time to pass to stop_timer
+ */
+uint64_t start_timer(void);
+
+/**
+ * Finishes timing a zone and records it.
+ *
+ * @param zone  the zone that was timed
+ * @param start the value returned by start_timer
+ */
+void stop_timer(profile_zone zone, uint64_t start);
+
+/**
+ * Records a zone that started at a time on SDL's millisecond clock, such as an
+ * event's timestamp, and finishes now.
+ *
+ * @param zone     the zone that was timed
+ * @param start_ms the start time in SDL ticks
+ */
+void stop_timer_from_ticks(profile_zone zone, uint32_t start_ms);
+
+/**
+ * Gets the median and 99th percentile of recent frame times.
+ *
+ * @param p50_us set to the median frame time in microseconds
+ * @param p99_us set to the 99th percentile frame time in microseconds
+ */
+void get_frame_percentiles(int *p50_us, int *p99_us);
+
+/**
+ * Gets the median and 99th percentile of recent input to present latencies.
+ * Input timestamps are to the millisecond.
+ */
+void get_latency_percentiles(int *p50_us, int *p99_us);
+
+/**
+ * Writes the recorded zones to a Chrome trace JSON file.
+ *
+ * @returns 0 on success, 1 if an error was encountered
+ */
+int write_trace(const char *path);
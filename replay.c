@@ -0,0 +1,193 @@
+/**
+ * Compact binary replay format. After the header each action takes two bytes
+ * or so -- the number of ticks since the previous action as a variable length
+ * integer followed by the action itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+
+#define REPLAY_MAGIC "TTRP"
+#define REPLAY_VERSION 1
+#define REPLAY_BUFFER_SIZE 65536
+
+struct replay
+{
+    FILE *file;
+    char buffer[REPLAY_BUFFER_SIZE]; // stdio buffer, actions are only written to disk when it fills
+    uint64_t seed;
+    randomizer randomizer;
+    uint64_t last_tick;              // tick of the last action read or written
+    engine_action next_action;       // playback only, the action due at last_tick
+    int finished;
+};
+
+/**
+ * Opens the file with a large stdio buffer
+ */
+static replay *open_replay(const char *path, const char *mode)
+{
+    FILE *file = fopen(path, mode);
+    if (!file)
+    {
+        fprintf(stderr, "Unable to open replay file %s\n", path);
+        return 0;
+    }
+
+    replay *replay = calloc(1, sizeof(struct replay));
+    if (!replay)
+    {
+        fprintf(stderr, "Unable to allocate a replay for %s\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    replay->file = file;
+    setvbuf(file, replay->buffer, _IOFBF, REPLAY_BUFFER_SIZE);
+
+    return replay;
+}
+
+static void write_varint(FILE *file, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+
+    fputc((int)value, file);
+}
+
+/**
+ * @returns 0 on success, 1 at the end of the file
+ */
+static int read_varint(FILE *file, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = fgetc(file);
+        if (c == EOF)
+        {
+            return 1;
+        }
+
+        *value |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Reads the next action and the tick it is due on
+ */
+static void read_action(replay *replay)
+{
+    uint64_t delta;
+    int action;
+    if (read_varint(replay->file, &delta) || (action = fgetc(replay->file)) == EOF)
+    {
+        replay->finished = 1;
+        return;
+    }
+
+    replay->last_tick += delta;
+    replay->next_action = action;
+}
+
+replay *open_replay_writer(const char *path, uint64_t seed, randomizer randomizer)
+{
+    replay *replay = open_replay(path, "wb");
+    if (!replay)
+    {
+        return 0;
+    }
+
+    fwrite(REPLAY_MAGIC, 1, 4, replay->file);
+    fputc(REPLAY_VERSION, replay->file);
+    fputc(randomizer, replay->file);
+    for (int i = 0; i < 8; i++)
+    {
+        fputc((int)(seed >> (i * 8)) & 0xFF, replay->file);
+    }
+
+    return replay;
+}
+
+void record_action(replay *replay, const engine *engine, engine_action action)
+{
+    write_varint(replay->file, engine->ticks - replay->last_tick);
+    fputc(action, replay->file);
+    replay->last_tick = engine->ticks;
+}
+
+replay *open_replay_reader(const char *path)
+{
+    replay *replay = open_replay(path, "rb");
+    if (!replay)
+    {
+        return 0;
+    }
+
+    unsigned char header[14];
+    if (fread(header, 1, sizeof(header), replay->file) != sizeof(header) ||
+        memcmp(header, REPLAY_MAGIC, 4) || header[4] != REPLAY_VERSION)
+    {
+        fprintf(stderr, "%s is not a replay file\n", path);
+        close_replay(replay);
+        return 0;
+    }
+
+    replay->randomizer = header[5];
+    for (int i = 0; i < 8; i++)
+    {
+        replay->seed |= (uint64_t)header[6 + i] << (i * 8);
+    }
+
+    read_action(replay);
+    return replay;
+}
+
+void replay_init_engine(replay *replay, engine *engine)
+{
+    engine_init(engine, replay->seed, replay->randomizer);
+}
+
+int play_actions(replay *replay, engine *engine)
+{
+    int events = 0;
+    while (!replay->finished && replay->last_tick <= engine->ticks)
+    {
+        events |= engine_step(engine, replay->next_action);
+        read_action(replay);
+    }
+
+    return events;
+}
+
+int is_replay_finished(replay *replay)
+{
+    return replay->finished;
+}
+
+void run_replay(replay *replay, engine *engine)
+{
+    while (!replay->finished)
+    {
+        play_actions(replay, engine);
+        engine_step(engine, ACTION_TICK);
+    }
+}
+
+void close_replay(replay *replay)
+{
+    fclose(replay->file);
+    free(replay);
+}
@@ -0,0 +1,62 @@
+/**
+ * Recording and playback of games. A replay is the seed and randomizer the game
+ * was started with followed by every action applied to it, each stamped with the
+ * engine tick it happened on. Since the engine is deterministic that is enough
+ * to play the game again exactly.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "engine.h"
+
+/**
+ * An open replay file, either being recorded or played back
+ */
+typedef struct replay replay;
+
+/**
+ * Creates a new replay file and writes its header.
+ *
+ * @returns the replay, 0 if an error was encountered
+ */
+replay *open_replay_writer(const char *path, uint64_t seed, randomizer randomizer);
+
+/**
+ * Records an action applied to the engine at its current tick.
+ */
+void record_action(replay *replay, const engine *engine, engine_action action);
+
+/**
+ * Opens a replay file for playback and reads its header.
+ *
+ * @returns the replay, 0 if an error was encountered
+ */
+replay *open_replay_reader(const char *path);
+
+/**
+ * Starts a game with the seed and randomizer the replay was recorded with.
+ */
+void replay_init_engine(replay *replay, engine *engine);
+
+/**
+ * Applies every recorded action due at the engine's current tick. Call before
+ * each ACTION_TICK.
+ *
+ * @returns the combined engine_event flags of the actions
+ */
+int play_actions(replay *replay, engine *engine);
+
+/**
+ * Checks if every recorded action has been played.
+ */
+int is_replay_finished(replay *replay);
+
+/**
+ * Plays the whole replay as fast as possible.
+ */
+void run_replay(replay *replay, engine *engine);
+
+/**
+ * Flushes and closes a replay file.
+ */
+void close_replay(replay *replay);
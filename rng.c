@@ -0,0 +1,32 @@
+/**
+ * PCG32, permuted congruential generator
+ */
+
+#include "rng.h"
+
+#define PCG_MULTIPLIER 6364136223846793005ULL
+
+void rng_seed(rng *rng, uint64_t seed)
+{
+    // Derive the stream from the seed too so that nearby seeds give unrelated sequences
+    rng->state = 0;
+    rng->inc = (seed << 1) | 1;
+    rng_next(rng);
+    rng->state += seed ^ 0x853C49E6748FEA9BULL;
+    rng_next(rng);
+}
+
+uint32_t rng_next(rng *rng)
+{
+    uint64_t old = rng->state;
+    rng->state = old * PCG_MULTIPLIER + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+uint32_t rng_range(rng *rng, uint32_t bound)
+{
+    // Multiply and shift rather than modulo, the bias is negligible for small bounds
+    return (uint32_t)(((uint64_t)rng_next(rng) * bound) >> 32);
+}
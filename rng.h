@@ -0,0 +1,33 @@
+/**
+ * Small, fast, seedable random number generator. Each game holds its own state
+ * so games are reproducible and independent of each other.
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * PCG32 generator state
+ *
+ * @see https://www.pcg-random.org
+ */
+typedef struct rng
+{
+    uint64_t state;
+    uint64_t inc;
+} rng;
+
+/**
+ * Seeds the generator. The same seed always produces the same sequence.
+ */
+void rng_seed(rng *rng, uint64_t seed);
+
+/**
+ * Gets the next 32 random bits.
+ */
+uint32_t rng_next(rng *rng);
+
+/**
+ * Gets a random number in the range 0 to bound - 1.
+ */
+uint32_t rng_range(rng *rng, uint32_t bound);
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+#include "arena.h"
+#include "assets.h"
+#include "profile.h"
+#include "scene.h"
+
+// Layout of the play area in pixels
+#define CELL_SIZE 25
+#define GRID_X_OFFSET 50
+#define GRID_Y_OFFSET 50
+#define GRID_WIDTH (GRID_CELL_WIDTH * CELL_SIZE)
+#define GRID_HEIGHT (GRID_CELL_HEIGHT * CELL_SIZE)
+
+#define BTN_SPRITE_WIDTH 125
+#define BTN_SPRITE_HEIGHT 40
+
+enum images { BUTTON_SHEET, GAME_OVER };
+enum sprites { PAUSE, RESTART, PAUSE_MO, RESTART_MO };
+
+typedef struct button
+{
+    int x;
+    int y;
+} button;
+
+struct scene
+{
+    int images[2];          // Loaded images
+    SDL_Rect btn_sprites[4]; // Button locations in the button sprite sheet
+    button pause;
+    button restart;
+    int background;         // Layer holding the parts of the scene that change only when a shape locks
+    int background_dirty;
+    int show_hud;           // Show frame time statistics
+    int hover;              // Bit per button, set when the mouse is over it
+};
+
+/**
+ * Renders the grid to the screen
+ */
+static void render_grid(graphics *graphics, const board *board)
+{
+    // Render outline
+    render_quad(graphics, GRID_X_OFFSET - 1, GRID_Y_OFFSET - 1, GRID_WIDTH + 2, GRID_HEIGHT + 2, 0, DARK);
+
+    // Render grid cells
+    int draw_x, draw_y;
+    for (int i = 0; i < GRID_CELL_HEIGHT; i++)
+    {
+        if (board->rows[i] == BOARD_EMPTY_ROW)
+        {
+            continue;
+        }
+
+        for (int j = 0; j < GRID_CELL_WIDTH; j++)
+        {
+            if (board->colors[i][j])
+            {
+                draw_x = GRID_X_OFFSET + (j * CELL_SIZE);
+                draw_y = GRID_Y_OFFSET + (i * CELL_SIZE);
+                render_quad(graphics, draw_x, draw_y, CELL_SIZE, CELL_SIZE, 1, board->colors[i][j]);
+            }
+        }
+    }
+}
+
+/**
+ * Renders the shape to the screen
+ *
+ * @param offset pixels to draw the shape below its row, for smooth falling
+ */
+static void render_shape_cells(graphics *graphics, const shape *shape, int offset)
+{
+    const tetronimo *tetronimo = get_tetronimo(shape->piece, shape->direction);
+    int draw_x, draw_y;
+    for (int i = tetronimo->top; i <= tetronimo->bottom; i++)
+    {
+        for (int j = tetronimo->left; j <= tetronimo->right; j++)
+        {
+            if (tetronimo->matrix[i][j])
+            {
+                draw_x = GRID_X_OFFSET + ((shape->x + j) * CELL_SIZE);
+                draw_y = GRID_Y_OFFSET + ((shape->y + i) * CELL_SIZE) + offset;
+                render_quad(graphics, draw_x, draw_y, CELL_SIZE, CELL_SIZE, 1, shape->color);
+            }
+        }
+    }
+}
+
+static int is_in_area(int area_x, int area_y, int width, int height, int x, int y)
+{
+    return (x >= area_x && x <= area_x + width && y >= area_y && y <= area_y + height);
+}
+
+static void init_ui(button *pause, button *restart)
+{
+    pause->x = GRID_WIDTH + GRID_X_OFFSET * 2;
+    pause->y = GRID_Y_OFFSET * 4;
+
+    restart->x = GRID_WIDTH + BTN_SPRITE_WIDTH + GRID_X_OFFSET * 3;
+    restart->y = GRID_Y_OFFSET * 4;
+}
+
+static int is_button_mouse_over(button *button)
+{
+    int mouse_x, mouse_y;
+    SDL_GetMouseState(&mouse_x, &mouse_y);
+    return is_in_area(button->x, button->y, BTN_SPRITE_WIDTH, BTN_SPRITE_HEIGHT, mouse_x, mouse_y);
+}
+
+/**
+ * Render game status information -- level and score.
+ */
+static void render_status(graphics *graphics, const game_state *state)
+{
+    char message[512];
+
+    // Level
+    sprintf(message, "Level %d", get_level(state));
+    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET);
+
+    // Score
+    sprintf(message, "Score %d", state->score);
+    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET * 2);
+
+    // Horizontal line
+    render_line(graphics, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET * 3, 375);
+}
+
+/**
+ * Render the interactive parts of the UI -- game over message, buttons.
+ */
+static void render_ui(graphics *graphics, const game_state *state, scene *scene)
+{
+    // Buttons
+    render_image(graphics, scene->images[BUTTON_SHEET], scene->pause.x, scene->pause.y,
+                 &scene->btn_sprites[is_button_mouse_over(&scene->pause) ? PAUSE_MO : PAUSE]);
+    render_image(graphics, scene->images[BUTTON_SHEET], scene->restart.x, scene->restart.y,
+                 &scene->btn_sprites[is_button_mouse_over(&scene->restart) ? RESTART_MO : RESTART]);
+
+    // Game over
+    if (state->action == STOPPED)
+    {
+        render_image(graphics, scene->images[GAME_OVER], GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET * 5, 0);
+    }
+}
+
+/**
+ * Render frame time and input latency statistics
+ */
+static void render_hud(graphics *graphics)
+{
+    char message[512];
+    int p50_us, p99_us;
+    get_frame_percentiles(&p50_us, &p99_us);
+
+    sprintf(message, "p50 us %d", p50_us);
+    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_HEIGHT - GRID_Y_OFFSET);
+
+    sprintf(message, "p99 us %d", p99_us);
+    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_HEIGHT);
+
+    get_latency_percentiles(&p50_us, &p99_us);
+
+    sprintf(message, "input p50 us %d", p50_us);
+    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_HEIGHT + GRID_Y_OFFSET);
+
+    sprintf(message, "input p99 us %d", p99_us);
+    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_HEIGHT + GRID_Y_OFFSET * 2);
+}
+
+/**
+ * Redraws the parts of the scene that only change when a shape locks or the game
+ * restarts -- the play area with its locked cells, the level and the score.
+ */
+static void render_background(graphics *graphics, int layer, const engine *engine)
+{
+    begin_layer(graphics, layer);
+    clear_frame(graphics);
+    render_grid(graphics, &engine->board);
+    render_status(graphics, &engine->state);
+    end_layer(graphics, layer);
+}
+
+static int load_images(scene *scene, graphics *graphics)
+{
+    // Load button sprite sheet
+    scene->images[BUTTON_SHEET] = load_image(graphics, assets_tetris_button_sheet_png, assets_tetris_button_sheet_png_len);
+    if (scene->images[BUTTON_SHEET] < 0)
+    {
+        return 1;
+    }
+
+    // Define sprites
+    for (int i = 0; i <= RESTART_MO; i++)
+    {
+        scene->btn_sprites[i] = (SDL_Rect){ 0, BTN_SPRITE_HEIGHT * i, BTN_SPRITE_WIDTH, BTN_SPRITE_HEIGHT };
+    }
+
+    // Load game over image
+    scene->images[GAME_OVER] = load_image(graphics, assets_tetris_go_png, assets_tetris_go_png_len);
+    if (scene->images[GAME_OVER] < 0)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+scene *init_scene(graphics *graphics)
+{
+    scene *scene = arena_alloc(sizeof(struct scene));
+    if (!scene || load_images(scene, graphics) || build_atlas(graphics))
+    {
+        close_scene(scene);
+        return 0;
+    }
+
+    init_ui(&scene->pause, &scene->restart);
+    scene->background = create_layer(graphics);
+    scene->background_dirty = 1;
+
+    return scene;
+}
+
+void render_scene(scene *scene, graphics *graphics, const engine *engine, float fall, int events)
+{
+    // Only redraw the background when it has changed, or every frame if there is no layer to keep it in
+    uint64_t zone_start = start_timer();
+    if (events & EVENT_LOCKED || scene->background_dirty || scene->background < 0)
+    {
+        render_background(graphics, scene->background, engine);
+        scene->background_dirty = 0;
+    }
+
+    render_layer(graphics, scene->background);
+    render_shape_cells(graphics, &engine->shape, (int)(fall * CELL_SIZE));
+    stop_timer(ZONE_RENDER_GRID, zone_start);
+
+    zone_start = start_timer();
+    render_ui(graphics, &engine->state, scene);
+    if (scene->show_hud)
+    {
+        render_hud(graphics);
+    }
+    stop_timer(ZONE_RENDER_UI, zone_start);
+}
+
+int update_hover(scene *scene)
+{
+    int hover = is_button_mouse_over(&scene->pause) | is_button_mouse_over(&scene->restart) << 1;
+    int changed = hover != scene->hover;
+    scene->hover = hover;
+    return changed;
+}
+
+void invalidate_scene(scene *scene)
+{
+    scene->background_dirty = 1;
+}
+
+void reset_scene(scene *scene, graphics *graphics)
+{
+    if (reset_textures(graphics))
+    {
+        scene->background = -1;
+    }
+
+    scene->background_dirty = 1;
+}
+
+void toggle_hud(scene *scene)
+{
+    scene->show_hud = !scene->show_hud;
+}
+
+engine_action click_scene(scene *scene)
+{
+    if (is_button_mouse_over(&scene->pause))
+    {
+        return ACTION_PAUSE;
+    }
+    else if (is_button_mouse_over(&scene->restart))
+    {
+        return ACTION_RESTART;
+    }
+
+    return ACTION_NONE;
+}
+
+void close_scene(scene *scene)
+{
+    // The scene lives in the arena and its images and layer belong to graphics, so there is nothing to free
+    (void)scene;
+}
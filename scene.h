@@ -0,0 +1,68 @@
+/**
+ * Draws the game -- the play area, the falling shape and the UI around them
+ */
+#pragma once
+
+#include "engine.h"
+#include "graphics.h"
+
+/**
+ * Struct to hold the images, buttons and cached layers used to draw the game
+ */
+typedef struct scene scene;
+
+/**
+ * Loads the images and sets up the UI. Allocated from the arena.
+ *
+ * @returns the scene, 0 if an error was encountered
+ */
+scene *init_scene(graphics *graphics);
+
+/**
+ * Renders a frame of the game. The locked cells, level and score are only
+ * redrawn when the scene has been invalidated or events include EVENT_LOCKED.
+ *
+ * @param scene    the scene
+ * @param graphics the graphics to draw with
+ * @param engine   the game to draw
+ * @param fall     how far the in-play shape is towards the next row, from 0 to 1
+ * @param events   engine_event flags from everything applied since the last frame
+ */
+void render_scene(scene *scene, graphics *graphics, const engine *engine, float fall, int events);
+
+/**
+ * Checks which buttons the mouse is over, after it has moved.
+ *
+ * @returns 1 if that has changed, so the buttons need redrawing, 0 otherwise
+ */
+int update_hover(scene *scene);
+
+/**
+ * Forces everything to be redrawn on the next frame, e.g. after the renderer
+ * has lost the contents of its layers.
+ */
+void invalidate_scene(scene *scene);
+
+/**
+ * Recreates the scene's textures after the render device has been reset. If
+ * the background's layer can't be recreated the background is drawn straight
+ * to the screen from then on.
+ */
+void reset_scene(scene *scene, graphics *graphics);
+
+/**
+ * Shows or hides frame time statistics.
+ */
+void toggle_hud(scene *scene);
+
+/**
+ * Works out what clicking the mouse at its current position does.
+ *
+ * @returns the action for the button under the mouse, ACTION_NONE if there isn't one
+ */
+engine_action click_scene(scene *scene);
+
+/**
+ * Releases the scene. It goes with the arena and its images with graphics.
+ */
+void close_scene(scene *scene);
@@ -0,0 +1,505 @@
+/**
+ * The game loop proper -- input, the bot and fixed rate ticks -- and the
+ * lock-free hand over of input and snapshots between threads
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+#include "arena.h"
+#include "bot.h"
+#include "profile.h"
+#include "simulation.h"
+
+#define MAX_TICKS_PER_STEP 10
+
+// Size of the input queue, must be a power of two
+#define INPUT_QUEUE_SIZE 64
+
+// Held soft drop moves the shape down a row every tick
+#define SOFT_DROP_INTERVAL_MS (1000 / ENGINE_TICK_RATE)
+
+// Sizes of the bot's transposition table, log2 of the number of entries
+#define TABLE_SCORE_BITS 16
+#define TABLE_PLACEMENT_BITS 12
+
+// Set in the shared triple buffer index when it holds a snapshot the reader hasn't taken
+#define SNAPSHOT_FRESH 4
+
+typedef struct queued_input
+{
+    input input;
+    uint32_t timestamp;
+} queued_input;
+
+struct simulation
+{
+    engine engine;
+    replay *recording;   // replay being recorded, if any
+    replay *playback;    // replay being played back, if any
+    int flags;
+    uint64_t last_counter; // performance counter value when the simulation was last advanced
+    uint64_t accumulator;  // time not yet simulated, in performance counter units * ENGINE_TICK_RATE
+    uint64_t tick_counter; // performance counter value when the last tick was due
+    unsigned locks;
+    unsigned version;    // of the last snapshot published
+    int autoplay;        // the bot is playing
+    int bot_pending;     // the bot needs to choose a placement for the in-play shape
+    placement target;    // where the bot is moving the in-play shape
+    transposition_table *table; // the bot's cache of placements and board measurements
+    repeat_timing shift;  // of held left and right
+    held_key keys[ACTION_RESTART + 1]; // indexed by action, only moves repeat
+    unsigned inputs;      // inputs applied so far
+    uint32_t input_ms;    // timestamp of the last input applied
+
+    // Written by the sending thread only at tail, read by the game only at head
+    queued_input queue[INPUT_QUEUE_SIZE];
+    atomic_uint input_head;
+    atomic_uint input_tail;
+
+    // The game writes to snapshots[back], the reader reads snapshots[front], and the
+    // two swap with whichever is in the middle
+    snapshot snapshots[3];
+    int back;
+    int front;
+    atomic_int middle;
+
+    SDL_Thread *thread;
+    SDL_sem *wake;       // posted when input is queued, or to stop the thread
+    atomic_int quit;
+};
+
+/**
+ * Applies an action to the game, recording it if required. Actions other than
+ * replayed ones are ignored while a replay is playing.
+ *
+ * @returns the engine_event flags from the action
+ */
+static int apply_action(simulation *simulation, engine_action action)
+{
+    if (action == ACTION_NONE || simulation->playback)
+    {
+        return 0;
+    }
+
+    if (simulation->recording)
+    {
+        record_action(simulation->recording, &simulation->engine, action);
+    }
+
+    return engine_step(&simulation->engine, action);
+}
+
+/**
+ * Checks if an action repeats while its key is held
+ */
+static int is_repeating(engine_action action)
+{
+    return action == ACTION_LEFT || action == ACTION_RIGHT || action == ACTION_DOWN;
+}
+
+/**
+ * Checks if a move would succeed, so that repeats against a wall or the stack
+ * aren't recorded
+ */
+static int can_move(const engine *engine, engine_action action)
+{
+    const shape *shape = &engine->shape;
+    int dx = action == ACTION_LEFT ? -1 : action == ACTION_RIGHT;
+    return engine->state.action == RUNNING && is_position_valid(get_tetronimo(shape->piece, shape->direction),
+                                                                shape->x + dx, shape->y + (action == ACTION_DOWN),
+                                                                &engine->board);
+}
+
+/**
+ * Repeats a move as many times as it can, up to the number of repeats
+ *
+ * @returns the combined engine_event flags of the moves
+ */
+static int repeat_move(simulation *simulation, engine_action action, int repeats)
+{
+    int events = 0;
+    for (; repeats > 0 && can_move(&simulation->engine, action); repeats--)
+    {
+        int result = apply_action(simulation, action);
+        if (!result)
+        {
+            break;
+        }
+
+        events |= result;
+    }
+
+    return events;
+}
+
+/**
+ * Makes the moves of held keys that have fallen due. Of left and right, only
+ * the one pressed last moves the shape.
+ *
+ * @param now_ms the time of the tick, in SDL ticks
+ * @returns      the combined engine_event flags of the moves
+ */
+static int run_held_keys(simulation *simulation, uint32_t now_ms)
+{
+    static const repeat_timing soft_drop = { SOFT_DROP_INTERVAL_MS, SOFT_DROP_INTERVAL_MS };
+    held_key *left = &simulation->keys[ACTION_LEFT];
+    held_key *right = &simulation->keys[ACTION_RIGHT];
+    int left_repeats = take_repeats(left, &simulation->shift, now_ms);
+    int right_repeats = take_repeats(right, &simulation->shift, now_ms);
+    int events = right->held && (!left->held || (int32_t)(right->pressed_ms - left->pressed_ms) > 0)
+                     ? repeat_move(simulation, ACTION_RIGHT, right_repeats)
+                     : repeat_move(simulation, ACTION_LEFT, left_repeats);
+
+    return events | repeat_move(simulation, ACTION_DOWN,
+                                take_repeats(&simulation->keys[ACTION_DOWN], &soft_drop, now_ms));
+}
+
+/**
+ * Applies the queued input
+ *
+ * @param events receives the combined engine_event flags of the actions
+ * @returns      the number of inputs applied
+ */
+static int apply_inputs(simulation *simulation, int *events)
+{
+    unsigned tail = atomic_load_explicit(&simulation->input_tail, memory_order_acquire);
+    unsigned head = atomic_load_explicit(&simulation->input_head, memory_order_relaxed);
+    for (; head != tail; head++)
+    {
+        const queued_input *queued = &simulation->queue[head & (INPUT_QUEUE_SIZE - 1)];
+        input input = queued->input;
+        if (input == INPUT_AUTOPLAY)
+        {
+            simulation->autoplay = !simulation->autoplay;
+            simulation->bot_pending = 1;
+        }
+        else if (input >= INPUT_ACTION_FIRST && input <= INPUT_ACTION_LAST)
+        {
+            *events |= apply_action(simulation, (engine_action)(input - INPUT_ACTION_FIRST));
+        }
+        else if (input >= INPUT_PRESS_FIRST && input <= INPUT_PRESS_LAST)
+        {
+            // Acts at once, any repeats come later with the ticks
+            engine_action action = input - INPUT_PRESS_FIRST;
+            *events |= apply_action(simulation, action);
+            if (is_repeating(action))
+            {
+                press_key(&simulation->keys[action], queued->timestamp);
+            }
+        }
+        else if (input >= INPUT_RELEASE_FIRST && input <= INPUT_RELEASE_LAST)
+        {
+            release_key(&simulation->keys[input - INPUT_RELEASE_FIRST]);
+        }
+
+        simulation->input_ms = queued->timestamp;
+    }
+
+    unsigned count = head - atomic_load_explicit(&simulation->input_head, memory_order_relaxed);
+    simulation->inputs += count;
+    atomic_store_explicit(&simulation->input_head, head, memory_order_release);
+    return count;
+}
+
+/**
+ * Makes the bot's next move, one action per tick so that it can be followed.
+ * Goes through apply_action so that the bot's moves are recorded like any other.
+ *
+ * @returns the engine_event flags from the action
+ */
+static int run_bot(simulation *simulation)
+{
+    if (!simulation->autoplay || simulation->engine.state.action != RUNNING)
+    {
+        return 0;
+    }
+
+    if (simulation->bot_pending)
+    {
+        bot_choose(&simulation->engine, 1, simulation->table, &simulation->target);
+        simulation->bot_pending = 0;
+    }
+
+    // If gravity has got the shape stuck on the way, drop it where it is
+    int events = apply_action(simulation, bot_next_action(&simulation->engine, &simulation->target));
+    return events ? events : apply_action(simulation, ACTION_DROP);
+}
+
+/**
+ * Runs a single simulation tick, with held keys' moves, the bot's move and any
+ * replay actions due first
+ *
+ * @param now_ms the time the tick was due, in SDL ticks
+ * @returns      the engine_event flags of the tick
+ */
+static int run_tick(simulation *simulation, uint32_t now_ms)
+{
+    int events = run_held_keys(simulation, now_ms);
+    events |= run_bot(simulation);
+    if (events & EVENT_LOCKED)
+    {
+        simulation->bot_pending = 1;
+    }
+
+    if (simulation->playback)
+    {
+        events |= play_actions(simulation->playback, &simulation->engine);
+    }
+
+    return events | engine_step(&simulation->engine, ACTION_TICK);
+}
+
+/**
+ * Runs however many fixed length simulation ticks have elapsed since the last
+ * call, measured with the high resolution clock. Game speed is therefore the
+ * same however often this is called.
+ *
+ * @returns the combined engine_event flags of the ticks
+ */
+static int advance_simulation(simulation *simulation)
+{
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint32_t now_ms = SDL_GetTicks();
+    simulation->accumulator += (now - simulation->last_counter) * ENGINE_TICK_RATE;
+    simulation->last_counter = now;
+
+    // Don't try to catch up after a long stall, e.g. the window being dragged
+    if (simulation->accumulator > frequency * MAX_TICKS_PER_STEP)
+    {
+        simulation->accumulator = frequency * MAX_TICKS_PER_STEP;
+    }
+
+    int events = 0;
+    while (simulation->accumulator >= frequency)
+    {
+        uint64_t late = (simulation->accumulator - frequency) / ENGINE_TICK_RATE;
+        events |= run_tick(simulation, now_ms - (uint32_t)(late * 1000 / frequency));
+        simulation->accumulator -= frequency;
+    }
+
+    simulation->tick_counter = now - simulation->accumulator / ENGINE_TICK_RATE;
+    return events;
+}
+
+/**
+ * Checks if the game has nothing to do until input arrives
+ */
+static int is_idle(const simulation *simulation)
+{
+    return simulation->engine.state.action != RUNNING && !simulation->playback;
+}
+
+/**
+ * Copies the game into the back buffer and swaps it into the middle for the reader to take
+ */
+static void publish_snapshot(simulation *simulation)
+{
+    snapshot *snapshot = &simulation->snapshots[simulation->back];
+    snapshot->engine = simulation->engine;
+    snapshot->version = ++simulation->version;
+    snapshot->tick_counter = simulation->tick_counter;
+    snapshot->locks = simulation->locks;
+    snapshot->inputs = simulation->inputs;
+    snapshot->input_ms = simulation->input_ms;
+    snapshot->replay_finished = simulation->playback && is_replay_finished(simulation->playback);
+
+    int previous = atomic_exchange_explicit(&simulation->middle, simulation->back | SNAPSHOT_FRESH,
+                                            memory_order_acq_rel);
+    simulation->back = previous & ~SNAPSHOT_FRESH;
+}
+
+/**
+ * Applies the queued input, runs the ticks due and publishes the result if
+ * anything happened. However often this is called, the game costs the same.
+ */
+static void run_step(simulation *simulation)
+{
+    uint64_t zone_start = start_timer();
+    uint64_t ticks = simulation->engine.ticks;
+    int events = 0;
+
+    // Time doesn't pass for an idle game, so it doesn't try to catch up once input wakes it
+    if (is_idle(simulation))
+    {
+        simulation->last_counter = SDL_GetPerformanceCounter();
+    }
+
+    int inputs = apply_inputs(simulation, &events);
+    if (simulation->flags & SIMULATION_FIXED_STEP)
+    {
+        events |= run_tick(simulation, SDL_GetTicks());
+    }
+    else if (!is_idle(simulation))
+    {
+        events |= advance_simulation(simulation);
+    }
+    if (events & EVENT_LOCKED)
+    {
+        simulation->locks++;
+        simulation->bot_pending = 1;
+    }
+
+    if (inputs || simulation->engine.ticks != ticks)
+    {
+        publish_snapshot(simulation);
+    }
+
+    stop_timer(ZONE_SIMULATION, zone_start);
+}
+
+/**
+ * Game thread. Steps whenever a tick is due or input arrives, sleeping in
+ * between. An idle game sleeps until input arrives.
+ */
+static int run_simulation(void *data)
+{
+    simulation *simulation = data;
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    while (!atomic_load(&simulation->quit))
+    {
+        run_step(simulation);
+        if (is_idle(simulation))
+        {
+            SDL_SemWait(simulation->wake);
+            continue;
+        }
+
+        // Rounded up, so the tick is due by the time it wakes
+        uint64_t remaining = frequency - simulation->accumulator;
+        uint32_t ms = (uint32_t)((remaining * 1000 + frequency * ENGINE_TICK_RATE - 1) / (frequency * ENGINE_TICK_RATE));
+        SDL_SemWaitTimeout(simulation->wake, ms);
+    }
+
+    return 0;
+}
+
+simulation *open_simulation(const engine *engine, replay *recording, replay *playback, int flags,
+                            const repeat_timing *shift)
+{
+    simulation *simulation = arena_alloc(sizeof(struct simulation));
+    if (!simulation)
+    {
+        return 0;
+    }
+
+    simulation->engine = *engine;
+    simulation->recording = recording;
+    simulation->playback = playback;
+    simulation->flags = flags;
+    simulation->shift = *shift;
+    simulation->last_counter = simulation->tick_counter = SDL_GetPerformanceCounter();
+    atomic_init(&simulation->input_head, 0);
+    atomic_init(&simulation->input_tail, 0);
+    atomic_init(&simulation->quit, 0);
+
+    void *table = arena_alloc(get_transposition_table_size(TABLE_SCORE_BITS, TABLE_PLACEMENT_BITS));
+    if (!table)
+    {
+        close_simulation(simulation);
+        return 0;
+    }
+
+    simulation->table = init_transposition_table(table, TABLE_SCORE_BITS, TABLE_PLACEMENT_BITS);
+
+    // Every buffer starts with the initial game so the reader always has something to draw
+    simulation->front = 0;
+    atomic_init(&simulation->middle, 1);
+    simulation->back = 2;
+    for (int i = 0; i < 3; i++)
+    {
+        simulation->snapshots[i] = (snapshot){ *engine, 0, simulation->tick_counter, 0, 0, 0, 0 };
+    }
+
+    if (flags & SIMULATION_THREADED)
+    {
+        simulation->wake = SDL_CreateSemaphore(0);
+        simulation->thread = SDL_CreateThread(run_simulation, "simulation", simulation);
+        if (!simulation->thread)
+        {
+            fprintf(stderr, "Unable to start simulation thread. SDL Error: %s\n", SDL_GetError());
+            close_simulation(simulation);
+            return 0;
+        }
+    }
+
+    return simulation;
+}
+
+int send_input(simulation *simulation, input input, uint32_t timestamp)
+{
+    // The action inputs come in blocks, one input for each engine_action
+    if (input == INPUT_NONE ||
+        (input < INPUT_AUTOPLAY && (input - INPUT_ACTION_FIRST) % (ACTION_RESTART + 1) == ACTION_NONE))
+    {
+        return 0;
+    }
+
+    // Drop the input if the game has fallen that far behind
+    unsigned tail = atomic_load_explicit(&simulation->input_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&simulation->input_head, memory_order_acquire) == INPUT_QUEUE_SIZE)
+    {
+        return 0;
+    }
+
+    simulation->queue[tail & (INPUT_QUEUE_SIZE - 1)] = (queued_input){ input, timestamp };
+    atomic_store_explicit(&simulation->input_tail, tail + 1, memory_order_release);
+    if (simulation->wake)
+    {
+        SDL_SemPost(simulation->wake);
+    }
+
+    return 1;
+}
+
+void step_simulation(simulation *simulation)
+{
+    run_step(simulation);
+}
+
+const snapshot *read_snapshot(simulation *simulation)
+{
+    if (atomic_load_explicit(&simulation->middle, memory_order_relaxed) & SNAPSHOT_FRESH)
+    {
+        int previous = atomic_exchange_explicit(&simulation->middle, simulation->front, memory_order_acq_rel);
+        simulation->front = previous & ~SNAPSHOT_FRESH;
+    }
+
+    return &simulation->snapshots[simulation->front];
+}
+
+float get_fall_progress(const snapshot *snapshot)
+{
+    const engine *engine = &snapshot->engine;
+    const shape *shape = &engine->shape;
+    if (engine->state.action != RUNNING ||
+        !is_position_valid(get_tetronimo(shape->piece, shape->direction), shape->x, shape->y + 1, &engine->board))
+    {
+        return 0;
+    }
+
+    // Ticks since the last one, capped at one in case the game is running behind
+    float ticks = (float)(SDL_GetPerformanceCounter() - snapshot->tick_counter) * ENGINE_TICK_RATE /
+                  SDL_GetPerformanceFrequency();
+    ticks = ticks < 1 ? ticks : 1;
+
+    float progress = (engine->state.gravity + ticks * get_gravity_per_tick(&engine->state)) / GRAVITY_ONE;
+    return progress < 1 ? progress : 1;
+}
+
+void close_simulation(simulation *simulation)
+{
+    if (simulation->thread)
+    {
+        atomic_store(&simulation->quit, 1);
+        SDL_SemPost(simulation->wake);
+        SDL_WaitThread(simulation->thread, 0);
+    }
+
+    if (simulation->wake)
+    {
+        SDL_DestroySemaphore(simulation->wake);
+    }
+}
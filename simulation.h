@@ -0,0 +1,106 @@
+/**
+ * Runs the game, on its own thread where threads are available, so that input
+ * and gravity are handled on time however long a frame takes to draw and
+ * present. Input is passed in through a single producer, single consumer
+ * queue and the game is passed back out as snapshots through a triple buffer,
+ * neither of which takes a lock.
+ */
+#pragma once
+
+#include "autorepeat.h"
+#include "engine.h"
+#include "replay.h"
+
+typedef struct simulation simulation;
+
+typedef enum simulation_flags
+{
+    SIMULATION_THREADED = 1,  // run on a thread of its own rather than in step_simulation
+    SIMULATION_FIXED_STEP = 2 // one tick per step_simulation whatever the time, so runs are repeatable
+} simulation_flags;
+
+/**
+ * Something for the game to do
+ */
+typedef enum input
+{
+    INPUT_NONE,
+    INPUT_ACTION_FIRST,                               // inputs up to INPUT_ACTION_LAST are engine actions
+    INPUT_ACTION_LAST = INPUT_ACTION_FIRST + ACTION_RESTART,
+    INPUT_PRESS_FIRST,                                // the key for an action pressed, moves repeat while it is held
+    INPUT_PRESS_LAST = INPUT_PRESS_FIRST + ACTION_RESTART,
+    INPUT_RELEASE_FIRST,                              // and released
+    INPUT_RELEASE_LAST = INPUT_RELEASE_FIRST + ACTION_RESTART,
+    INPUT_AUTOPLAY                                    // toggles the bot playing
+} input;
+
+#define INPUT_ACTION(action) ((input)(INPUT_ACTION_FIRST + (action)))
+#define INPUT_PRESS(action) ((input)(INPUT_PRESS_FIRST + (action)))
+#define INPUT_RELEASE(action) ((input)(INPUT_RELEASE_FIRST + (action)))
+
+/**
+ * A complete copy of the game, published each time the game changes
+ */
+typedef struct snapshot
+{
+    engine engine;
+    unsigned version;      // counts up with every snapshot published
+    uint64_t tick_counter; // performance counter value when the engine's last tick was due
+    unsigned locks;        // shapes locked and games restarted so far, a change means the board has changed
+    unsigned inputs;       // inputs applied so far
+    uint32_t input_ms;     // timestamp of the last input applied
+    int replay_finished;   // the replay being played back, if any, has no more actions
+} snapshot;
+
+/**
+ * Sets up the game and, if threaded, starts it running. Allocated from the
+ * arena.
+ *
+ * @param engine    the game to run, copied
+ * @param recording replay to record actions to, may be 0
+ * @param playback  replay to play actions from, may be 0
+ * @param flags     simulation_flags
+ * @param shift     delayed auto shift and auto repeat rate of held left and right keys
+ * @returns         the simulation, 0 if an error was encountered
+ */
+simulation *open_simulation(const engine *engine, replay *recording, replay *playback, int flags,
+                            const repeat_timing *shift);
+
+/**
+ * Queues an input for the game. Must only be called from one thread. A
+ * snapshot is always published after input, so a change in version shows
+ * that the game has seen it.
+ *
+ * @param timestamp when the input happened, in SDL ticks, e.g. the event's timestamp
+ * @returns         1 if the input was queued, 0 if there was nothing to do or the queue is full
+ */
+int send_input(simulation *simulation, input input, uint32_t timestamp);
+
+/**
+ * Applies the queued input and runs the ticks due. Only for simulations that
+ * aren't threaded, call once per frame. Paused and finished games don't tick
+ * unless a replay is playing, which needs the ticks to reach its next action.
+ */
+void step_simulation(simulation *simulation);
+
+/**
+ * Gets the most recently published snapshot. It stays valid and unchanged
+ * until the next call. Must only be called from one thread.
+ */
+const snapshot *read_snapshot(simulation *simulation);
+
+/**
+ * Works out how far the in-play shape has fallen towards the next row by now,
+ * from the gravity at the snapshot's last tick and the time since. Used to
+ * draw the shape moving smoothly between ticks at any frame rate.
+ *
+ * @returns the fraction of a row, 0 if the shape can't fall any further
+ */
+float get_fall_progress(const snapshot *snapshot);
+
+/**
+ * Stops the game's thread, if any, and frees its resources. The simulation
+ * and the bot's transposition table go with the arena and replays are left
+ * open.
+ */
+void close_simulation(simulation *simulation);
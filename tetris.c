@@ -1,61 +1,29 @@
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 #include <SDL2/SDL.h>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-#include "tetronimoes.h"
+#include "arena.h"
+#include "engine.h"
 #include "graphics.h"
+#include "profile.h"
+#include "replay.h"
+#include "scene.h"
+#include "simulation.h"
 
-#define CELL_SIZE 25
-#define GRID_X_OFFSET 50
-#define GRID_Y_OFFSET 50
-#define GRID_CELL_WIDTH 12
-#define GRID_CELL_HEIGHT 18
-#define GRID_WIDTH GRID_CELL_WIDTH * CELL_SIZE
-#define GRID_HEIGHT GRID_CELL_HEIGHT * CELL_SIZE
-#define SCREEN_FPS 60
-#define SCREEN_TICKS_PER_FRAME (1000 / SCREEN_FPS)
-#define INITIAL_SPEED 90
-#define BTN_SPRITE_WIDTH 125
-#define BTN_SPRITE_HEIGHT 40
+// Longest wait for an event when idle, as a backstop
+#define IDLE_TIMEOUT_MS 1000
 
-/**
- * An in-play tetronimo
- */
-typedef struct shape
-{
-    tetronimo *tetronimo; // the selected tetronimo
-    color color;          // index to the color array
-    int x;                // x pixel position relative to the top left of the grid
-    int y;                // y pixel position relative to the top left of the grid
-} shape;
+// Room for the graphics, scene and simulation, most of it the bot's transposition table
+#define ARENA_SIZE (2 * 1024 * 1024)
 
-enum images { BUTTON_SHEET, GAME_OVER };
-enum sprites { PAUSE, RESTART, PAUSE_MO, RESTART_MO };
-typedef enum game_action { RUNNING, PAUSED, STOPPED } game_action;
-
-/**
- * Variables to control the state of the game
- */
-typedef struct game_state
-{
-    int speed;
-    int loop_count;
-    game_action action;
-    int num_pieces;
-    int score;
-    int images[2];
-    SDL_Rect **btn_sprites;
-} game_state;
-
-typedef struct button
-{
-    int x;
-    int y;
-} button;
+// Delayed auto shift and auto repeat rate of held left and right, 10 and 2 ticks
+#define DEFAULT_SHIFT_DELAY_MS 167
+#define DEFAULT_SHIFT_INTERVAL_MS 33
 
 /**
  * Required for emscripten compatability.
@@ -63,246 +31,117 @@ typedef struct button
 typedef struct game_data
 {
     graphics *graphics;
-    int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH];
-    shape shape;
-    game_state state;
+    simulation *simulation;
+    scene *scene;
     SDL_Event e;
     uint32_t start_ms;
     int quit;
-    button pause;
-    button restart;
+    replay *playback;    // replay being played back in real time, if any
+    int headless;        // no window, the game runs one tick per frame as fast as it can
+    int threaded;        // the game runs on its own thread
+    int hidden;          // the window is hidden or minimized
+    int paused;          // the game is paused or over, so the scene only changes on input
+    int awaiting;        // input has been sent that the game hasn't published the result of yet
+    unsigned version;    // the last snapshot read
+    unsigned locks;      // locks in the last snapshot drawn
+    unsigned inputs;     // inputs in the last snapshot drawn
 } game_data;
 
-// Macros to convert pixel positions to positions in the grid array
-#define CONVERT_TO_X_GRID(x) (x - GRID_X_OFFSET) / CELL_SIZE
-#define CONVERT_TO_Y_GRID(y) (y - GRID_Y_OFFSET) / CELL_SIZE
-
-/**
- * Renders the grid to the screen
- */
-static void render_grid(graphics *graphics, int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH])
-{
-    // Render outline
-    render_quad(graphics, GRID_X_OFFSET - 1, GRID_Y_OFFSET - 1, GRID_WIDTH + 2, GRID_HEIGHT + 2, 0, DARK);
-
-    // Render grid cells
-    int draw_x, draw_y;
-    for (int i = 0; i < GRID_CELL_HEIGHT; i++)
-    {
-        for (int j = 0; j < GRID_CELL_WIDTH; j++)
-        {
-            if (grid[i][j])
-            {
-                draw_x = GRID_X_OFFSET + (j * CELL_SIZE);
-                draw_y = GRID_Y_OFFSET + (i * CELL_SIZE);
-                render_quad(graphics, draw_x, draw_y, CELL_SIZE, CELL_SIZE, 1, grid[i][j]);
-            }
-        }
-    }
-}
-
-/**
- * Renders the shape to the screen
- */
-static void render_shape_cells(graphics *graphics, shape *shape)
-{
-    int draw_x, draw_y;
-    for (int i = 0; i < MATRIX_SIZE; i++)
-    {
-        for (int j = 0; j < MATRIX_SIZE; j++)
-        {
-            if (shape->tetronimo->matrix[i][j])
-            {
-                draw_x = shape->x + (j * CELL_SIZE);
-                draw_y = shape->y + (i * CELL_SIZE);
-                render_quad(graphics, draw_x, draw_y, CELL_SIZE, CELL_SIZE, 1, shape->color);
-            }
-        }
-    }
-}
-
-/**
- * Gets the current level from the game state
- */
-static int get_level(game_state *state)
-{
-    return ((INITIAL_SPEED - state->speed) / 10) + 1;
-}
-
-static int is_in_area(int area_x, int area_y, int width, int height, int x, int y)
-{
-    return (x >= area_x && x <= area_x + width && y >= area_y && y <= area_y + height);
-}
-
-static void init_ui(button *pause, button *restart)
-{
-    pause->x = GRID_WIDTH + GRID_X_OFFSET * 2;
-    pause->y = GRID_Y_OFFSET * 4;
-
-    restart->x = GRID_WIDTH + BTN_SPRITE_WIDTH + GRID_X_OFFSET * 3;
-    restart->y = GRID_Y_OFFSET * 4;
-}
-
-static int is_button_mouse_over(button *button)
-{
-    int mouse_x, mouse_y;
-    SDL_GetMouseState(&mouse_x, &mouse_y);
-    return is_in_area(button->x, button->y, BTN_SPRITE_WIDTH, BTN_SPRITE_HEIGHT, mouse_x, mouse_y);
-}
-
 /**
- * Render game status information -- score, game over message, buttons.
- */
-static void render_ui(graphics *graphics, game_state *state, button *pause, button *restart)
-{
-    char message[512];
-    int mouse_x, mouse_y;
-    SDL_GetMouseState(&mouse_x, &mouse_y);
-
-    // Level
-    sprintf(message, "Level %d", get_level(state));
-    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET);
-
-    // Score
-    sprintf(message, "Score %d", state->score);
-    render_message(graphics, message, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET * 2);
-
-    // Horizontal line
-    render_line(graphics, GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET * 3, 375);
-
-    // Buttons
-    render_image(graphics, state->images[BUTTON_SHEET], pause->x, pause->y,
-                 state->btn_sprites[is_button_mouse_over(pause) ? PAUSE_MO : PAUSE]);
-    render_image(graphics, state->images[BUTTON_SHEET], restart->x, restart->y,
-                 state->btn_sprites[is_button_mouse_over(restart) ? RESTART_MO : RESTART]);
-
-    // Game over
-    if (state->action == STOPPED)
-    {
-        render_image(graphics, state->images[GAME_OVER], GRID_WIDTH + GRID_X_OFFSET * 2, GRID_Y_OFFSET * 5, 0);
-    }
-}
-
-/**
- * Checks to see if the pixel coordinates are outside of the grid.
- */
-static int is_out_of_bounds(int x, int y)
-{
-    return (x + CELL_SIZE - GRID_X_OFFSET > GRID_WIDTH ||
-            x < GRID_X_OFFSET ||
-            y + CELL_SIZE - GRID_Y_OFFSET > GRID_HEIGHT);
-}
-
-/**
- * Checks to see if the tetronimo at the given coordinates fits in the
- * play area and does not overlap any cells in the grid.
- * 
- * @param tetronimo the tetronimo to check
- * @param new_x     the proposed x pixel position
- * @param new_y     the proposed y pixel position
- * @param grid      the current game grid state
- * @returns         1 if the position is valid, 0 otherwise
- */
-static int is_position_valid(tetronimo *tetronimo, int new_x, int new_y, int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH])
-{
-    int draw_x, draw_y, grid_x, grid_y;
-    for (int i = 0; i < MATRIX_SIZE; i++)
-    {
-        for (int j = 0; j < MATRIX_SIZE; j++)
-        {
-            if (tetronimo->matrix[i][j])
-            {
-                draw_x = new_x + (j * CELL_SIZE);
-                draw_y = new_y + (i * CELL_SIZE);
-                grid_x = CONVERT_TO_X_GRID(draw_x);
-                grid_y = CONVERT_TO_Y_GRID(draw_y);
-                if (is_out_of_bounds(draw_x, draw_y) || grid[grid_y][grid_x])
-                {
-                    return 0;
-                }
-            }
-        }
-    }
-
-    return 1;
-}
-
-/**
- * Handles keyboard input. Updates the shape with the new coordinates and rotation.
+ * Handles keyboard input. Maps the key to an engine action.
  * 
  * @param key_code the key pressed by the user
- * @param shape    the current in-play shape
- * @param grid     the play area
- * @param state    the game state
+ * @returns        the action, ACTION_NONE if the key does nothing
  */
-static void handle_keys(SDL_Keycode key_code, shape *shape, int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH], game_state *state)
+static engine_action handle_keys(SDL_Keycode key_code)
 {
-    if (state->action != RUNNING)
-    {
-        return;
-    }
-
     switch (key_code)
     {
     case SDLK_DOWN:
-        shape->y += is_position_valid(shape->tetronimo, shape->x, shape->y + CELL_SIZE, grid) ? CELL_SIZE : 0;
-        break;
+        return ACTION_DOWN;
     case SDLK_LEFT:
-        shape->x -= is_position_valid(shape->tetronimo, shape->x - CELL_SIZE, shape->y, grid) ? CELL_SIZE : 0;
-        break;
+        return ACTION_LEFT;
     case SDLK_RIGHT:
-        shape->x += is_position_valid(shape->tetronimo, shape->x + CELL_SIZE, shape->y, grid) ? CELL_SIZE : 0;
-        break;
+        return ACTION_RIGHT;
     case SDLK_x:
-        rotate(shape->tetronimo, NINETY_DEGREES);
-        if (!is_position_valid(shape->tetronimo, shape->x, shape->y, grid))
-        {
-            rotate(shape->tetronimo, TWO_SEVENTY_DEGREES);
-        }
-        break;
+        return ACTION_ROTATE_CW;
     case SDLK_z:
-        rotate(shape->tetronimo, TWO_SEVENTY_DEGREES);
-        if (!is_position_valid(shape->tetronimo, shape->x, shape->y, grid))
-        {
-            rotate(shape->tetronimo, NINETY_DEGREES);
-        }
-        break;
+        return ACTION_ROTATE_CCW;
     }
+
+    return ACTION_NONE;
+}
+
+static void cleanup(game_data *data)
+{
+    close_scene(data->scene);
+
+#ifdef __EMSCRIPTEN__
+    emscripten_cancel_main_loop();
+#endif
 }
 
 /**
- * Removes row from the grid if it is full.
- * 
- * @returns 1 if the row was removed, 0 otherwise
+ * Handles an event from SDL
+ *
+ * @returns 1 if the scene needs redrawing, 0 otherwise
  */
-static int remove_full_row(int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH], int row)
+static int handle_event(game_data *data, const SDL_Event *e)
 {
-    int count = 0;
-    for (int col = 0; col < GRID_CELL_WIDTH; col++)
+    switch (e->type)
     {
-        if (grid[row][col])
+    case SDL_QUIT:
+        data->quit = 1;
+        return 0;
+    case SDL_MOUSEBUTTONDOWN:
+        data->awaiting |= send_input(data->simulation, INPUT_ACTION(click_scene(data->scene)), e->button.timestamp);
+        return 1;
+    case SDL_MOUSEMOTION:
+        return update_hover(data->scene);
+    case SDL_KEYDOWN:
+        // Held keys are repeated by the game, timed from the press, not by the OS
+        if (e->key.repeat)
         {
-            count++;
+            return 0;
         }
-    }
 
-    if (count == GRID_CELL_WIDTH)
-    {
-        // Shift everything in the grid down from row up to the second row
-        for (int r = row; r > 0; r--)
+        if (e->key.keysym.sym == SDLK_F3)
         {
-            for (int col = 0; col < GRID_CELL_WIDTH; col++)
-            {
-                grid[r][col] = grid[r - 1][col];
-            }
+            toggle_hud(data->scene);
         }
-
-        // Clear out the top row
-        for (int col = 0; col < GRID_CELL_WIDTH; col++)
+        else if (e->key.keysym.sym == SDLK_a)
         {
-            grid[0][col] = 0;
+            data->awaiting |= send_input(data->simulation, INPUT_AUTOPLAY, e->key.timestamp);
         }
 
+        data->awaiting |= send_input(data->simulation, INPUT_PRESS(handle_keys(e->key.keysym.sym)),
+                                     e->key.timestamp);
+        return 1;
+    case SDL_KEYUP:
+        data->awaiting |= send_input(data->simulation, INPUT_RELEASE(handle_keys(e->key.keysym.sym)),
+                                     e->key.timestamp);
+        return 0;
+    case SDL_WINDOWEVENT:
+        switch (e->window.event)
+        {
+        case SDL_WINDOWEVENT_HIDDEN:
+        case SDL_WINDOWEVENT_MINIMIZED:
+            data->hidden = 1;
+            return 0;
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_EXPOSED:
+            data->hidden = 0;
+            return 1;
+        }
+        return 0;
+    case SDL_RENDER_TARGETS_RESET:
+        // Layer contents are lost
+        invalidate_scene(data->scene);
+        return 1;
+    case SDL_RENDER_DEVICE_RESET:
+        // The textures themselves are lost
+        reset_scene(data->scene, data->graphics);
         return 1;
     }
 
@@ -310,256 +149,250 @@ static int remove_full_row(int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH], int row)
 }
 
 /**
- * Original Nintendo scoring system.
+ * Waits for an event to arrive, leaving it queued for handle_events
  */
-static void update_score(game_state *state, int num_rows)
+static void wait_for_event(void)
 {
-    static int SCORE_TABLE[5] = { 0, 40, 100, 300, 1200 };
-    state->score += SCORE_TABLE[num_rows] * get_level(state);
+#ifndef __EMSCRIPTEN__
+    // The browser calls back every frame regardless, so there is no waiting there
+    SDL_WaitEventTimeout(0, IDLE_TIMEOUT_MS);
+#endif
 }
 
 /**
- * Adds the tetronimo to the playing area. Removes full rows and updates the game score.
+ * Handles the events waiting
+ *
+ * @returns 1 if the scene needs redrawing, 0 otherwise
  */
-static void add_shape_to_grid(int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH], shape *shape, game_state *state)
+static int handle_events(game_data *data)
 {
-    int grid_x, grid_y, row_count = 0;
-    for (int i = 0; i < MATRIX_SIZE; i++)
+    int redraw = 0;
+    while (SDL_PollEvent(&data->e))
     {
-        grid_y = CONVERT_TO_Y_GRID(shape->y + (i * CELL_SIZE));
-
-        for (int j = 0; j < MATRIX_SIZE; j++)
-        {
-            if (shape->tetronimo->matrix[i][j])
-            {
-                grid_x = CONVERT_TO_X_GRID(shape->x + (j * CELL_SIZE));
-                grid[grid_y][grid_x] = shape->color;
-            }
-        }
-
-        row_count += remove_full_row(grid, grid_y);
+        redraw |= handle_event(data, &data->e);
     }
 
-    update_score(state, row_count);
+    return redraw;
 }
 
-/**
- * Sets up a new random shape at the top of the screen with a random color
- */
-static void reset_shape(shape *shape)
+static void main_loop(void *g_data)
 {
-    shape->tetronimo = get_random_tetronimo();
-    if (shape->tetronimo->direction != NONE && shape->tetronimo->direction != UP)
+    game_data *data = g_data;
+
+    // Nothing changes on screen while the game is paused or over, or can be seen while the window is hidden,
+    // so wait for something to happen. Not while input is on its way to the game though, or the change of
+    // state it brings could be missed. The wait is outside the frame so it isn't timed as part of it.
+    if (!data->headless && !data->awaiting && (data->hidden || data->paused))
     {
-        rotate(shape->tetronimo, 4 - shape->tetronimo->direction);
+        wait_for_event();
     }
 
-    shape->color = (rand() % BLUE) + 1;
-    shape->x = (GRID_WIDTH / 2) + GRID_X_OFFSET;
-    shape->y = GRID_Y_OFFSET;
-}
-
-static void init_game(game_state *state)
-{
-    state->num_pieces = 1;
-    state->action = RUNNING;
-    state->speed = INITIAL_SPEED;
-    state->score = 0;
-}
+    data->start_ms = SDL_GetTicks();
+    uint64_t frame_start = start_timer();
+    uint64_t zone_start = start_timer();
+    int redraw = handle_events(data);
+    stop_timer(ZONE_INPUT, zone_start);
 
-static int load_images(game_state *state, graphics *graphics)
-{
-    // Load button sprite sheet
-    state->images[BUTTON_SHEET] = load_image(graphics, "assets/tetris_button_sheet.png");
-    if (state->images[BUTTON_SHEET] < 0)
+    // Otherwise the game is running on its own thread and has already seen the input
+    if (!data->threaded)
     {
-        return 1;
+        step_simulation(data->simulation);
     }
 
-    // Define sprites
-    state->btn_sprites = calloc(4, sizeof(SDL_Rect*));
-    for (int i = 0; i <= RESTART_MO; i++)
+    const snapshot *snapshot = read_snapshot(data->simulation);
+    if (snapshot->version != data->version)
     {
-        state->btn_sprites[i] = calloc(1, sizeof(SDL_Rect));
-        state->btn_sprites[i]->x = 0;
-        state->btn_sprites[i]->y = BTN_SPRITE_HEIGHT * i;
-        state->btn_sprites[i]->w = BTN_SPRITE_WIDTH;
-        state->btn_sprites[i]->h = BTN_SPRITE_HEIGHT;
+        data->version = snapshot->version;
+        data->awaiting = 0;
+        redraw = 1;
     }
 
-    // Load game over image
-    state->images[GAME_OVER] = load_image(graphics, "assets/tetris_go.png");
-    if (state->images[GAME_OVER] < 0)
+    // A running game is redrawn every frame for the falling shape
+    data->paused = snapshot->engine.state.action != RUNNING && !data->playback;
+    if (data->hidden || (data->paused && !redraw))
     {
-        return 1;
+        return;
     }
 
-    return 0;
-}
+    // The board only needs redrawing if a shape has locked since the last frame
+    int events = snapshot->locks != data->locks ? EVENT_LOCKED : 0;
+    data->locks = snapshot->locks;
 
-/**
- * Prepare the state for the next frame
- */
-static void new_frame(game_state *state)
-{
-    state->loop_count += state->action == RUNNING ? 1 : 0;
-}
+    // Headless frames are drawn exactly on the tick
+    float fall = data->headless ? 0 : get_fall_progress(snapshot);
+    render_scene(data->scene, data->graphics, &snapshot->engine, fall, events);
 
-/**
- * Checks if it is time to increase the level of difficulty, i.e. increase
- * the speed that tetronimoes drop down.
- */
-static void check_level(game_state *state)
-{
-    if (state->num_pieces % 10 == 0 && state->speed > 10)
+    zone_start = start_timer();
+    commit_to_screen(data->graphics);
+    stop_timer(ZONE_COMMIT, zone_start);
+    stop_timer(ZONE_FRAME, frame_start);
+    check_frame_allocations();
+
+    // Only the last input in each frame is timed, earlier ones were superseded before they could be seen
+    if (snapshot->inputs != data->inputs)
     {
-        state->speed -= 10;
+        stop_timer_from_ticks(ZONE_INPUT_LATENCY, snapshot->input_ms);
+        data->inputs = snapshot->inputs;
     }
-}
 
-/**
- * Checks if it is time to force the tetronimo down a row.
- */
-static int check_force_down(game_state *state)
-{
-    if (state->loop_count == state->speed)
+    if (data->headless)
     {
-        state->loop_count = 0;
-        return 1;
+        // Nobody to give input, so stop at the end of the replay or the game
+        data->quit |= data->playback ? snapshot->replay_finished : snapshot->engine.state.action == STOPPED;
+        return;
     }
 
-    return 0;
-}
-
-static void cleanup(game_state *state)
-{
-    for (int i = 0; i <= RESTART_MO; i++)
+    // Presenting waits for vsync, so there is only any need to wait here if the driver couldn't
+    int interval = get_frame_interval(data->graphics);
+    int frameTicks = SDL_GetTicks() - data->start_ms;
+    if (frameTicks < interval)
     {
-        free(state->btn_sprites[i]);
+        SDL_Delay(interval - frameTicks);
     }
-
-    free(state->btn_sprites);
-
-#ifdef __EMSCRIPTEN__
-    emscripten_cancel_main_loop();
-#endif
 }
 
 /**
- * End of life for a shape. Add it to the grid and select a new one.
- * Check for end of game and the level of difficulty.
+ * Plays a replay with no rendering as fast as the engine can go and reports the result
  */
-static void end_shape(game_state *state, int grid[GRID_CELL_HEIGHT][GRID_CELL_WIDTH], shape *shape)
+static int run_fast_replay(replay *replay)
 {
-    add_shape_to_grid(grid, shape, state);
-    reset_shape(shape);
-    state->num_pieces++;
-    if (!is_position_valid(shape->tetronimo, shape->x, shape->y, grid))
-    {
-        shape->color = RED;
-        state->action = STOPPED;
-    }
+    engine engine;
+    replay_init_engine(replay, &engine);
 
-    check_level(state);
-}
+    clock_t start = clock();
+    run_replay(replay, &engine);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
 
-/**
- * Handles mouse button click events. Pauses or restarts the game.
- * 
- * @param needs pretty much everything to handle restarts
- */
-static void handle_mouse(game_data *data)
-{
-    int mouse_x, mouse_y;
-    SDL_GetMouseState(&mouse_x, &mouse_y);
-    if (is_button_mouse_over(&data->pause) && (&data->state)->action != STOPPED)
-    {
-        (&data->state)->action = (&data->state)->action == RUNNING ? PAUSED : RUNNING;
-    }
-    else if (is_button_mouse_over(&data->restart))
-    {
-        init_game(&data->state);
-        reset_shape(&data->shape);
-        for (int i = 0; i < GRID_CELL_HEIGHT; i++)
-        {
-            for (int j = 0; j < GRID_CELL_WIDTH; j++)
-            {
-                data->grid[i][j] = 0;
-            }
-        }
-    }
+    printf("ticks %llu, pieces %d, score %d, level %d, %.3f seconds\n", (unsigned long long)engine.ticks,
+           engine.state.num_pieces, engine.state.score, get_level(&engine.state), seconds);
+    close_replay(replay);
+    return 0;
 }
 
-static void main_loop(void *g_data)
+int main(int argc, char *argv[])
 {
-    game_data *data = g_data;
-    data->start_ms = SDL_GetTicks();
-    new_frame(&data->state);
-
-    while (SDL_PollEvent(&data->e))
+    uint64_t seed = time(0);
+    randomizer randomizer = RANDOMIZER_UNIFORM;
+    const char *record_path = 0;
+    const char *play_path = 0;
+    const char *trace_path = 0;
+    const char *capture_pattern = 0;
+    int graphics_flags = 0;
+    int fast = 0;
+    repeat_timing shift = { DEFAULT_SHIFT_DELAY_MS, DEFAULT_SHIFT_INTERVAL_MS };
+    int opt;
+    while ((opt = getopt(argc, argv, "s:br:p:ft:Ho:d:a:")) != -1)
     {
-        switch (data->e.type)
+        switch (opt)
         {
-        case SDL_QUIT:
-            data->quit = 1;
+        case 's':
+            seed = strtoull(optarg, 0, 10);
+            break;
+        case 'b':
+            randomizer = RANDOMIZER_BAG;
+            break;
+        case 'r':
+            record_path = optarg;
+            break;
+        case 'p':
+            play_path = optarg;
+            break;
+        case 'f':
+            fast = 1;
+            break;
+        case 't':
+            trace_path = optarg;
+            break;
+        case 'H':
+            graphics_flags |= GRAPHICS_HEADLESS;
             break;
-        case SDL_MOUSEBUTTONDOWN:
-            handle_mouse(data);
+        case 'o':
+            capture_pattern = optarg;
             break;
-        case SDL_KEYDOWN:
-            handle_keys(data->e.key.keysym.sym, &data->shape, data->grid, &data->state);
+        case 'd':
+            shift.delay_ms = strtoul(optarg, 0, 10);
             break;
+        case 'a':
+            shift.interval_ms = strtoul(optarg, 0, 10);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-s seed] [-b] [-r record_file | -p replay_file [-f]] [-t trace_file] [-H] "
+                            "[-o frame_pattern] [-d shift_delay_ms] [-a shift_interval_ms]\n", argv[0]);
+            return 1;
         }
     }
 
-    if (check_force_down(&data->state))
+    init_tetronimoes();
+
+    game_data game_data = { 0 };
+    replay *recording = 0;
+    if (play_path)
     {
-        if (is_position_valid(data->shape.tetronimo, data->shape.x, data->shape.y + CELL_SIZE, data->grid))
+        game_data.playback = open_replay_reader(play_path);
+        if (!game_data.playback)
         {
-            data->shape.y += CELL_SIZE;
+            return 1;
         }
-        else
+
+        if (fast)
         {
-            end_shape(&data->state, data->grid, &data->shape);
+            return run_fast_replay(game_data.playback);
+        }
+    }
+    else if (record_path)
+    {
+        recording = open_replay_writer(record_path, seed, randomizer);
+        if (!recording)
+        {
+            return 1;
         }
     }
 
-    clear_frame(data->graphics);
-
-    render_grid(data->graphics, data->grid);
-    render_shape_cells(data->graphics, &data->shape);
-    render_ui(data->graphics, &data->state, &data->pause, &data->restart);
-
-    commit_to_screen(data->graphics);
-
-    // Limit FPS to avoid maxing out CPU
-    int frameTicks = SDL_GetTicks() - data->start_ms;
-    if (frameTicks < SCREEN_TICKS_PER_FRAME)
+    if (init_arena(ARENA_SIZE))
     {
-        SDL_Delay(SCREEN_TICKS_PER_FRAME - frameTicks);
+        return 1;
     }
-}
 
-int main()
-{
-    game_data game_data = { 0 };
-    game_data.graphics = init_graphics();
+    game_data.headless = graphics_flags & GRAPHICS_HEADLESS;
+    game_data.graphics = init_graphics(graphics_flags);
     if (!game_data.graphics)
     {
         return 1;
     }
 
-    srand(time(0));
+    if (capture_pattern && start_capture(game_data.graphics, capture_pattern))
+    {
+        return 1;
+    }
 
-    if (load_images(&game_data.state, game_data.graphics))
+    game_data.scene = init_scene(game_data.graphics);
+    if (!game_data.scene)
     {
         return 1;
     }
 
-    init_ui(&game_data.pause, &game_data.restart);
+    engine engine;
+    if (game_data.playback)
+    {
+        replay_init_engine(game_data.playback, &engine);
+    }
+    else
+    {
+        engine_init(&engine, seed, randomizer);
+    }
 
-    init_game(&game_data.state);
-    reset_shape(&game_data.shape);
+    // Headless frames are a fixed tick apart so captured frames are the same every run
+    int simulation_flags = game_data.headless ? SIMULATION_FIXED_STEP : 0;
+#ifndef __EMSCRIPTEN__
+    game_data.threaded = !game_data.headless;
+    simulation_flags |= game_data.threaded ? SIMULATION_THREADED : 0;
+#endif
+
+    game_data.simulation = open_simulation(&engine, recording, game_data.playback, simulation_flags, &shift);
+    if (!game_data.simulation)
+    {
+        return 1;
+    }
 
     while (!game_data.quit)
     {
@@ -570,7 +403,24 @@ int main()
 #endif
     }
 
+    close_simulation(game_data.simulation);
+    if (trace_path)
+    {
+        write_trace(trace_path);
+    }
+
+    if (recording)
+    {
+        close_replay(recording);
+    }
+
+    if (game_data.playback)
+    {
+        close_replay(game_data.playback);
+    }
+
     close_graphics(game_data.graphics);
-    cleanup(&game_data.state);
+    cleanup(&game_data);
+    close_arena();
     return 0;
 }
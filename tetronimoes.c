@@ -1,14 +1,21 @@
 /**
- * Rotate a tetronimo 90, 180 or 270 degrees
+ * Tetronimo orientation tables. Each tetronimo is rotated through 90, 180 and 270
+ * degrees once at startup, after which rotating is just a change of table index.
  */
 
-#include <stdio.h>
-#include <stdlib.h>
 #include "tetronimoes.h"
+#include "zobrist.h"
 
-#define NUM_TETRONIMOES 7
+/**
+ * The starting shape of a tetronimo and whether it can be rotated
+ */
+typedef struct base_shape
+{
+    int matrix[MATRIX_SIZE][MATRIX_SIZE];
+    int rotates;
+} base_shape;
 
-static tetronimo tetronimoes[NUM_TETRONIMOES] = {
+static const base_shape base_shapes[NUM_TETRONIMOES] = {
     {
         {
             { 0, 1, 0, 0 },
@@ -16,7 +23,7 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 1, 1, 0 },
             { 0, 0, 0, 0 }
         },
-        UP
+        1
     },
     {
         {
@@ -25,7 +32,7 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 0, 1, 0 },
             { 0, 0, 1, 0 }
         },
-        UP
+        1
     },
     {
         {
@@ -34,7 +41,7 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 0, 0, 0 },
             { 0, 0, 0, 0 }
         },
-        NONE
+        0
     },
     {
         {
@@ -43,7 +50,7 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 0, 1, 0 },
             { 0, 0, 0, 0 }
         },
-        UP
+        1
     },
     {
         {
@@ -52,7 +59,7 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 0, 1, 0 },
             { 0, 0, 0, 0 }
         },
-        UP
+        1
     },
     {
         {
@@ -61,7 +68,7 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 1, 1, 0 },
             { 0, 0, 0, 0 }
         },
-        UP
+        1
     },
     {
         {
@@ -70,10 +77,13 @@ static tetronimo tetronimoes[NUM_TETRONIMOES] = {
             { 0, 1, 0, 0 },
             { 0, 0, 0, 0 }
         },
-        UP
+        1
     }
 };
 
+// Every orientation of every tetronimo, indexed by id and direction
+static tetronimo orientations[NUM_TETRONIMOES][NUM_DIRECTIONS];
+
 static void swap(int *a, int *b)
 {
     int tmp = *a;
@@ -103,46 +113,71 @@ static void reverse_rows(int matrix[MATRIX_SIZE][MATRIX_SIZE])
     }
 }
 
-static void reverse_cols(int matrix[MATRIX_SIZE][MATRIX_SIZE])
+/**
+ * Fills in a tetronimo orientation from its matrix, working out the row bitmasks
+ * and the bounding box.
+ */
+static void build_orientation(tetronimo *tetronimo, int matrix[MATRIX_SIZE][MATRIX_SIZE])
 {
-    for (int y = 0; y < MATRIX_SIZE / 2; y++)
+    tetronimo->left = tetronimo->top = MATRIX_SIZE;
+    tetronimo->right = tetronimo->bottom = -1;
+    for (int y = 0; y < MATRIX_SIZE; y++)
     {
+        tetronimo->rows[y] = 0;
         for (int x = 0; x < MATRIX_SIZE; x++)
         {
-            swap(&matrix[y][x], &matrix[MATRIX_SIZE - 1 - y][x]);
+            tetronimo->matrix[y][x] = matrix[y][x];
+            if (matrix[y][x])
+            {
+                tetronimo->rows[y] |= 1 << x;
+                tetronimo->left = x < tetronimo->left ? x : tetronimo->left;
+                tetronimo->right = x > tetronimo->right ? x : tetronimo->right;
+                tetronimo->top = y < tetronimo->top ? y : tetronimo->top;
+                tetronimo->bottom = y > tetronimo->bottom ? y : tetronimo->bottom;
+            }
         }
     }
 }
 
-tetronimo *get_random_tetronimo()
+void init_tetronimoes(void)
 {
-    return &tetronimoes[rand() % NUM_TETRONIMOES];
+    int matrix[MATRIX_SIZE][MATRIX_SIZE];
+    for (int id = 0; id < NUM_TETRONIMOES; id++)
+    {
+        for (int y = 0; y < MATRIX_SIZE; y++)
+        {
+            for (int x = 0; x < MATRIX_SIZE; x++)
+            {
+                matrix[y][x] = base_shapes[id].matrix[y][x];
+            }
+        }
+
+        // Each direction is a further 90 degree clockwise turn
+        for (int d = UP; d < NUM_DIRECTIONS; d++)
+        {
+            build_orientation(&orientations[id][d], matrix);
+            if (base_shapes[id].rotates)
+            {
+                transpose_square(matrix);
+                reverse_rows(matrix);
+            }
+        }
+    }
+
+    init_zobrist();
 }
 
-void rotate(tetronimo *tetronimo, rotation rotation)
+const tetronimo *get_tetronimo(int id, direction direction)
 {
-    if (tetronimo->direction == NONE)
-    {
-        return;
-    }
+    return &orientations[id][direction];
+}
 
-    switch (rotation)
+direction rotate(int id, direction direction, rotation rotation)
+{
+    if (!base_shapes[id].rotates)
     {
-    case NINETY_DEGREES:
-        transpose_square(tetronimo->matrix);
-        reverse_rows(tetronimo->matrix);
-        break;
-    case ONE_EIGHTY_DEGREES:
-        reverse_rows(tetronimo->matrix);
-        reverse_cols(tetronimo->matrix);
-        break;
-    case TWO_SEVENTY_DEGREES:
-        reverse_rows(tetronimo->matrix);
-        transpose_square(tetronimo->matrix);
-        break;
-    default:
-        break;
+        return direction;
     }
 
-    tetronimo->direction = (tetronimo->direction + rotation) % 4;
+    return (direction + rotation) % NUM_DIRECTIONS;
 }
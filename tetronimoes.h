@@ -3,15 +3,18 @@
  */
 #pragma once
 
+#include <stdint.h>
+
 // tetronimoes are defined in a 4 X 4 matrix
 #define MATRIX_SIZE 4
+#define NUM_TETRONIMOES 7
+#define NUM_DIRECTIONS 4
 
 /**
  * The direction the tetronimo is facing
  */
 typedef enum direction
 {
-    NONE = -1, // tetronimo cannot be rotated
     UP,
     RIGHT,
     DOWN,
@@ -29,25 +32,43 @@ typedef enum rotation
 } rotation;
 
 /**
- * A tetris piece.
+ * A tetris piece in one of its orientations. Orientations are generated once
+ * by init_tetronimoes and are read-only after that, so they can be shared by
+ * any number of games.
  */
 typedef struct tetronimo
 {
     int matrix[MATRIX_SIZE][MATRIX_SIZE]; // The shape of the tetronimo
-    direction direction;                  // The tetronimo's current direction
+    uint8_t rows[MATRIX_SIZE];            // Row bitmasks, bit n set for matrix column n
+    int left;                             // Bounding box of the filled cells in the matrix
+    int top;
+    int right;
+    int bottom;
 } tetronimo;
 
 /**
- * Selects a random tetronimo from those available.
+ * Builds the orientation tables for every tetronimo, and the Zobrist keys.
+ * Must be called once before any of the other functions, and before starting
+ * any threads.
+ */
+void init_tetronimoes(void);
+
+/**
+ * Gets a tetronimo in the given orientation.
+ *
+ * @param id        the tetronimo id
+ * @param direction the direction the tetronimo is facing
  */
-tetronimo *get_random_tetronimo();
+const tetronimo *get_tetronimo(int id, direction direction);
 
 /**
- * Rotates a tetronimo in place and maintains a record if its direction
- * 
- * @param tetronimo the tetronimo to rotate
- * @param rotation the rotation direction
- * 
- * @see https://stackoverflow.com/a/8664879
+ * Works out the direction a tetronimo faces after a rotation. Tetronimoes that
+ * cannot be rotated keep their direction. Nothing is modified, so a rejected
+ * rotation costs nothing to undo.
+ *
+ * @param id        the tetronimo id
+ * @param direction the current direction
+ * @param rotation  the rotation direction
+ * @returns         the new direction
  */
-void rotate(tetronimo *tetronimo, rotation rotation);
+direction rotate(int id, direction direction, rotation rotation);
@@ -0,0 +1,104 @@
+/**
+ * Lockless transposition table. Words are read and written with relaxed
+ * atomics, the key check is what detects an entry being changed underneath
+ * a reader.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "transposition.h"
+
+#define SCORE_WORDS 1
+
+struct transposition_table
+{
+    uint64_t score_mask;
+    uint64_t placement_mask;
+    _Atomic uint64_t *scores;     // entries of a check word then SCORE_WORDS of data
+    _Atomic uint64_t *placements; // entries of a check word then TT_PLACEMENT_WORDS of data
+};
+
+/**
+ * Reads an entry, checking it was stored with the given key and has not been torn
+ */
+static int probe(_Atomic uint64_t *entry, int words, uint64_t key, uint64_t *data)
+{
+    uint64_t check = atomic_load_explicit(&entry[0], memory_order_relaxed);
+    for (int i = 0; i < words; i++)
+    {
+        data[i] = atomic_load_explicit(&entry[i + 1], memory_order_relaxed);
+        check ^= data[i];
+    }
+
+    return check == key;
+}
+
+static void store(_Atomic uint64_t *entry, int words, uint64_t key, const uint64_t *data)
+{
+    uint64_t check = key;
+    for (int i = 0; i < words; i++)
+    {
+        atomic_store_explicit(&entry[i + 1], data[i], memory_order_relaxed);
+        check ^= data[i];
+    }
+
+    atomic_store_explicit(&entry[0], check, memory_order_relaxed);
+}
+
+size_t get_transposition_table_size(int score_bits, int placement_bits)
+{
+    return sizeof(transposition_table) + ((size_t)1 << score_bits) * (SCORE_WORDS + 1) * sizeof(uint64_t) +
+           ((size_t)1 << placement_bits) * (TT_PLACEMENT_WORDS + 1) * sizeof(uint64_t);
+}
+
+transposition_table *init_transposition_table(void *memory, int score_bits, int placement_bits)
+{
+    // The entries follow the table in the same block
+    transposition_table *table = memory;
+    table->score_mask = ((uint64_t)1 << score_bits) - 1;
+    table->placement_mask = ((uint64_t)1 << placement_bits) - 1;
+    table->scores = (_Atomic uint64_t *)(table + 1);
+    table->placements = table->scores + ((size_t)1 << score_bits) * (SCORE_WORDS + 1);
+    return table;
+}
+
+transposition_table *open_transposition_table(int score_bits, int placement_bits)
+{
+    void *memory = calloc(1, get_transposition_table_size(score_bits, placement_bits));
+    if (!memory)
+    {
+        fprintf(stderr, "Unable to allocate the transposition table\n");
+        return 0;
+    }
+
+    return init_transposition_table(memory, score_bits, placement_bits);
+}
+
+void close_transposition_table(transposition_table *table)
+{
+    free(table);
+}
+
+int probe_score(transposition_table *table, uint64_t key, uint64_t *score)
+{
+    return probe(&table->scores[(key & table->score_mask) * (SCORE_WORDS + 1)], SCORE_WORDS, key, score);
+}
+
+void store_score(transposition_table *table, uint64_t key, uint64_t score)
+{
+    store(&table->scores[(key & table->score_mask) * (SCORE_WORDS + 1)], SCORE_WORDS, key, &score);
+}
+
+int probe_placements(transposition_table *table, uint64_t key, uint64_t placements[TT_PLACEMENT_WORDS])
+{
+    return probe(&table->placements[(key & table->placement_mask) * (TT_PLACEMENT_WORDS + 1)], TT_PLACEMENT_WORDS,
+                 key, placements);
+}
+
+void store_placements(transposition_table *table, uint64_t key, const uint64_t placements[TT_PLACEMENT_WORDS])
+{
+    store(&table->placements[(key & table->placement_mask) * (TT_PLACEMENT_WORDS + 1)], TT_PLACEMENT_WORDS, key,
+          placements);
+}
@@ -0,0 +1,64 @@
+/**
+ * Transposition table. Caches work done on a position, keyed by its Zobrist
+ * hash, so that search and batch runs don't repeat it when they meet the same
+ * position again. The table has a fixed size and is shared between threads
+ * without locks: each entry is stored with its key XORed with its data, so an
+ * entry torn by a concurrent write no longer matches its key and reads as a
+ * miss. Newer entries simply replace older ones.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of the data cached for a set of placements
+#define TT_PLACEMENT_WORDS 13
+
+typedef struct transposition_table transposition_table;
+
+/**
+ * Creates an empty table.
+ *
+ * @param score_bits     log2 of the number of score entries
+ * @param placement_bits log2 of the number of placement set entries
+ * @returns              the table, 0 if it could not be allocated
+ */
+transposition_table *open_transposition_table(int score_bits, int placement_bits);
+
+/**
+ * Gets the bytes of memory a table needs, for init_transposition_table.
+ */
+size_t get_transposition_table_size(int score_bits, int placement_bits);
+
+/**
+ * Creates an empty table in memory the caller provides, e.g. from an arena.
+ * The memory must be zeroed, aligned for uint64_t and at least
+ * get_transposition_table_size bytes. It stays the caller's, so the table
+ * must not be closed.
+ *
+ * @returns the table
+ */
+transposition_table *init_transposition_table(void *memory, int score_bits, int placement_bits);
+
+/**
+ * Frees a table created by open_transposition_table.
+ */
+void close_transposition_table(transposition_table *table);
+
+/**
+ * Looks up the score of a position.
+ *
+ * @returns 1 if found, 0 otherwise
+ */
+int probe_score(transposition_table *table, uint64_t key, uint64_t *score);
+
+void store_score(transposition_table *table, uint64_t key, uint64_t score);
+
+/**
+ * Looks up the placements reachable from a position.
+ *
+ * @returns 1 if found, 0 otherwise
+ */
+int probe_placements(transposition_table *table, uint64_t key, uint64_t placements[TT_PLACEMENT_WORDS]);
+
+void store_placements(transposition_table *table, uint64_t key, const uint64_t placements[TT_PLACEMENT_WORDS]);
@@ -0,0 +1,85 @@
+/**
+ * Zobrist keys, generated once and read-only after that
+ */
+
+#include "rng.h"
+#include "zobrist.h"
+
+#define ZOBRIST_SEED 0x5A0B4157ULL
+
+// Shapes can sit up to a matrix width off the board on any side
+#define X_KEYS (GRID_CELL_WIDTH + 2 * MATRIX_SIZE)
+#define Y_KEYS (GRID_CELL_HEIGHT + 2 * MATRIX_SIZE)
+
+static uint64_t cell_keys[GRID_CELL_HEIGHT][32]; // indexed by row bit, only the play area bits are used
+static uint64_t piece_keys[NUM_TETRONIMOES][NUM_DIRECTIONS];
+static uint64_t x_keys[X_KEYS];
+static uint64_t y_keys[Y_KEYS];
+
+static uint64_t next_key(rng *rng)
+{
+    uint64_t high = rng_next(rng);
+    return (high << 32) | rng_next(rng);
+}
+
+void init_zobrist(void)
+{
+    rng rng;
+    rng_seed(&rng, ZOBRIST_SEED);
+    for (int row = 0; row < GRID_CELL_HEIGHT; row++)
+    {
+        for (int col = 0; col < GRID_CELL_WIDTH; col++)
+        {
+            cell_keys[row][BOARD_WALL + col] = next_key(&rng);
+        }
+    }
+
+    for (int piece = 0; piece < NUM_TETRONIMOES; piece++)
+    {
+        for (int d = UP; d < NUM_DIRECTIONS; d++)
+        {
+            piece_keys[piece][d] = next_key(&rng);
+        }
+    }
+
+    for (int i = 0; i < X_KEYS; i++)
+    {
+        x_keys[i] = next_key(&rng);
+    }
+
+    for (int i = 0; i < Y_KEYS; i++)
+    {
+        y_keys[i] = next_key(&rng);
+    }
+}
+
+uint64_t zobrist_cells(int row, uint32_t cells)
+{
+    uint64_t key = 0;
+    for (cells &= ~BOARD_EMPTY_ROW; cells; cells &= cells - 1)
+    {
+        key ^= cell_keys[row][__builtin_ctz(cells)];
+    }
+
+    return key;
+}
+
+uint64_t zobrist_piece(int piece, direction direction)
+{
+    return piece_keys[piece][direction];
+}
+
+uint64_t zobrist_x(int x)
+{
+    return x_keys[x + MATRIX_SIZE];
+}
+
+uint64_t zobrist_y(int y)
+{
+    return y_keys[y + MATRIX_SIZE];
+}
+
+uint64_t zobrist_shape(int piece, direction direction, int x, int y)
+{
+    return zobrist_piece(piece, direction) ^ zobrist_x(x) ^ zobrist_y(y);
+}
@@ -0,0 +1,44 @@
+/**
+ * Zobrist hashing. Every filled cell, and the in-play shape's piece,
+ * direction and position, has a random 64 bit key and a position's hash is
+ * the XOR of its keys, so it can be updated as cells are filled or the shape
+ * moves without looking at the rest of the board.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "board.h"
+
+/**
+ * Generates the keys. They come from a fixed seed so hashes are the same
+ * every run. Called by init_tetronimoes.
+ */
+void init_zobrist(void);
+
+/**
+ * Gets the combined key of the filled play area cells in a board row.
+ *
+ * @param row   the grid row
+ * @param cells the row's bits, as held in a board, anything outside the play area is ignored
+ */
+uint64_t zobrist_cells(int row, uint32_t cells);
+
+/**
+ * Gets the key of a tetronimo in one of its orientations.
+ */
+uint64_t zobrist_piece(int piece, direction direction);
+
+/**
+ * Gets the key of a shape's grid column, which may be a little off the board.
+ */
+uint64_t zobrist_x(int x);
+
+/**
+ * Gets the key of a shape's grid row, which may be a little off the board.
+ */
+uint64_t zobrist_y(int y);
+
+/**
+ * Gets the key of a shape in the given orientation and position.
+ */
+uint64_t zobrist_shape(int piece, direction direction, int x, int y);